@@ -7,18 +7,34 @@
 #ifndef LED_H
 #define LED_H
 
+#include "led_config.h"
 #include "user_led.h"
 #include "sequence.h"
 
 #include <stdint.h>
 #include <stdbool.h>
 
-#define LEDS_MAX 64
+#if LEDS_MAX > (1 << HANDLE_SLOT_BITS)
+#error "LEDS_MAX must fit in the slot bits of an LED ID"
+#endif
+
+/** sequence_id of the unregistered slots copied by led_read_table(). */
+#define LED_SLOT_FREE (-2)
+
+/** Number of 64 bit words needed to hold one bit per LED. */
+#define LED_MASK_WORDS ((LEDS_MAX + 63) / 64)
+
+/** Playback rate that plays sequences at their own speed, rates have 8 fractional bits. */
+#define LED_RATE_1X 256
+
+/** Number of buckets in the update time histogram, bucket n counts updates of 2^(n-1) to 2^n - 1 cycles. */
+#define LED_STATS_BUCKETS 33
 
 /**
  * @brief Holds state information for an led's configuration.
  * 
- * @param enabled       - True if led is in use, false otherwise.
+ * @param enabled       - True if led is in use, false otherwise. Only read by led_register(), use led_enable() 
+ *                        and led_disable() afterwards.
  * @param pinout        - A pinout object that defines connection of the led to the microcontroller.
  * @param sequence_id   - A pointer to a sequence object that defines the flash pattern of the led.
  * @param sequence_idx  - Maintains the position in the assigned sequence that the LED is up to
@@ -55,6 +71,184 @@ typedef enum{
 /* User defined hardware layer function that changes the LED state on the target device */
 void write(pins_t, led_state_t);
 
+/**
+ * @brief Function that changes the LED state on the target device, write() by default.
+ */
+typedef void (*led_write_fn_t)(pins_t, led_state_t);
+
+/**
+ * @brief A sequence shown on an LED in place of its assigned sequence for a while.
+ */
+typedef struct{
+    int32_t sequence_id;                /**Sequence shown while the overlay is on top. */
+    uint32_t expires_ms;                /**Time since init the overlay is removed at. */
+    uint8_t priority;                   /**Higher priorities are shown over lower ones. */
+    bool timed;                         /**False if the overlay stays until it is popped. */
+}led_overlay_t;
+
+/**
+ * @brief The assigned sequence of an LED and where it was in it, kept while overlays are shown.
+ */
+typedef struct{
+    led_t led;                          /**Sequence, position and timer of the LED. */
+    uint32_t serviced_ms;               /**Time the position was last brought up to date. */
+    uint16_t repeats_left;              /**Plays left, see led_assign_sequence_repeat(). */
+    int32_t next_sequence;              /**Sequence moved on to when the plays run out. */
+    bool held;                          /**True if the plays had already run out. */
+}led_overlay_base_t;
+
+/**
+ * @brief Things that can happen to an LED during an update that the application can be told about.
+ */
+typedef enum{
+    LED_EVENT_CYCLE,        /**The sequence wrapped back to its first state. */
+    LED_EVENT_FINISHED,     /**A sequence with a repeat count played its last time. */
+    LED_EVENT_COUNT
+}led_event_t;
+
+/**
+ * @brief Called from led_dispatch_events() with every LED an event happened to since the last dispatch.
+ * Bit n of the mask is LED (word * 64 + n).
+ */
+typedef void (*led_event_fn_t)(led_event_t event, uint32_t word, uint64_t mask);
+
+/**
+ * @brief Commands that can be queued for an update to apply.
+ */
+typedef enum{
+    LED_CMD_ASSIGN_SEQUENCE,
+    LED_CMD_ENABLE,
+    LED_CMD_DISABLE,
+    LED_CMD_OFFSET_SEQUENCE,
+    LED_CMD_UPDATE_SEQUENCE
+}led_cmd_type_t;
+
+/**
+ * @brief A slot in the command ring. The slot's sequence number tells producers and the
+ * consumer whose turn it is to use the slot, so no slot is read while it is being written.
+ * Only accessed atomically.
+ */
+typedef struct{
+    uint32_t seq;
+    led_cmd_type_t type;
+    int32_t led_id;
+    int32_t arg;
+}led_cmd_slot_t;
+
+/**
+ * @brief An LED state waiting to be written, see led_ctx_update_words().
+ */
+typedef struct{
+    pins_t pinout;
+    led_state_t state;
+}led_output_t;
+
+/**
+ * @brief User supplied free running cycle counter used to time updates, e.g. reading DWT->CYCCNT.
+ */
+typedef uint32_t (*led_cycle_counter_fn_t)(void);
+
+/**
+ * @brief Timing of the updates, collected when built with LED_INSTRUMENTATION.
+ */
+typedef struct{
+    uint32_t calls;                         /**Number of updates timed. */
+    uint32_t min_cycles;                    /**Shortest update. */
+    uint32_t max_cycles;                    /**Longest update. */
+    uint32_t mean_cycles;                   /**Average update, filled in when read. */
+    uint64_t total_cycles;                  /**Sum of every update. */
+    uint32_t overruns;                      /**Number of updates longer than the budget. */
+    uint32_t histogram[LED_STATS_BUCKETS];  /**Number of updates by log2 of their duration. */
+}led_stats_t;
+
+/**
+ * @brief One transition recorded by the trace. Packed into 8 bytes so the ring can be dumped 
+ * from memory and read back on a host, see test-harness/trace.
+ */
+typedef struct{
+    uint32_t time_ms;                   /**Time since init of the update that made the transition. */
+    uint16_t led_id;                    /**LED that changed. */
+    uint8_t old_state;                  /**led_state_t written before, LED_UNDEFINED for the first write. */
+    uint8_t new_state;                  /**led_state_t written now. */
+}led_trace_entry_t;
+
+struct scene_ctx;
+
+/**
+ * @brief Holds the complete state of one independent bank of LEDs. Each context has its own LEDs, timer
+ * period and output function and can be updated from its own timer or core. The led_* functions without 
+ * a context use a default context. The fields are private to the driver, use the led_ctx_* functions.
+ */
+typedef struct led_ctx{
+    led_t leds[LEDS_MAX];               /**The registered LEDs. */
+    uint32_t count;                     /**Number of slots used so far, registered or free. */
+    uint16_t generations[LEDS_MAX];     /**Generation of each slot, see HANDLE_MAKE(). */
+    uint16_t free_next[LEDS_MAX];       /**The free slot after each free slot. */
+    uint16_t free_head;                 /**First free slot, valid when free_count is not 0. */
+    uint32_t free_count;                /**Number of unregistered slots waiting to be reused. */
+    uint64_t free_mask[LED_MASK_WORDS]; /**Set bits are unregistered slots below count. */
+    uint32_t timer_period;              /**Period in ms that the update is called at. */
+    sequence_ctx_t * sequences;         /**Table the LEDs' sequence IDs refer to. */
+    struct scene_ctx * scenes;          /**Scenes applied at the start of each update, NULL if none. */
+    led_write_fn_t write;               /**Writes an LED state to the hardware. */
+
+    uint64_t enabled_mask[LED_MASK_WORDS];  /**Bit n of word w is set if LED (w * 64 + n) is enabled. */
+    uint64_t active_mask[LED_MASK_WORDS];   /**Set bits are LEDs that still have work to do in the update. */
+    uint64_t priority_mask[LED_MASK_WORDS]; /**Set bits are LEDs serviced first by budgeted updates. */
+
+    uint32_t now_ms;                    /**Time in ms since init. */
+    uint32_t update_count;              /**Number of updates since init. */
+    uint32_t serviced_ms[LEDS_MAX];     /**Time each LED was last serviced. */
+    uint16_t rate_divisor[LEDS_MAX];    /**Each LED is serviced every rate_divisor updates. */
+    uint16_t rate_phase[LEDS_MAX];      /**Which of those updates the LED is serviced on. */
+    uint16_t tolerance_ms[LEDS_MAX];    /**How late each LED's transitions may be. */
+    uint16_t playback_rate[LEDS_MAX];   /**Speed each LED plays its sequence at, LED_RATE_1X for normal speed. */
+    uint8_t playback_fraction[LEDS_MAX]; /**Fraction of a ms of sequence time carried to the next update. */
+    uint16_t repeats_left[LEDS_MAX];    /**Plays of each LED's sequence left, 0 if it loops forever. */
+    int32_t next_sequence[LEDS_MAX];    /**Sequence each LED moves on to when its plays run out, -1 for none. */
+    bool sequence_held[LEDS_MAX];       /**True once an LED's plays have run out with nothing to move on to. */
+    uint64_t swap_mask[LED_MASK_WORDS]; /**LEDs whose sequence was updated and that haven't stepped since. */
+    uint8_t swap_state[LEDS_MAX];       /**State those LEDs keep showing until their next step. */
+
+#ifdef LED_OVERLAYS
+    led_overlay_t overlays[LEDS_MAX][LED_OVERLAY_DEPTH]; /**Each LED's overlays, lowest priority first. */
+    uint8_t overlay_depth[LEDS_MAX];    /**Number of overlays on each LED. */
+    led_overlay_base_t overlay_base[LEDS_MAX]; /**Assigned sequence of each LED with overlays. */
+    uint64_t overlay_timed_mask[LED_MASK_WORDS]; /**LEDs with at least one timed overlay. */
+    uint32_t overlay_timed_count;       /**Number of timed overlays on all LEDs. */
+    uint32_t overlay_next_expiry;       /**No timed overlay expires before this time. */
+#endif
+
+    led_event_fn_t event_callback;      /**Receives the events, NULL if they aren't recorded. */
+    uint64_t event_masks[LED_EVENT_COUNT][LED_MASK_WORDS]; /**LEDs each event has happened to since the last dispatch. */
+    uint32_t priority_cursor;           /**Where budgeted updates resume for priority LEDs. */
+    uint32_t normal_cursor;             /**Where budgeted updates resume for other LEDs. */
+
+    led_cmd_slot_t cmd_ring[LED_COMMAND_QUEUE_SIZE]; /**Commands waiting for the next update. */
+    uint32_t cmd_tail;                  /**Position the next producer claims. */
+    uint32_t cmd_head;                  /**Position the update reads next. */
+
+    uint32_t state_seq;                 /**Odd while the state is being changed. */
+    uint32_t state_write_depth;         /**Number of nested state changes in progress. */
+
+#ifdef LED_BATCH
+    bool batch_update;                  /**True if updates step LEDs with the batch kernel. */
+#endif
+
+#ifdef LED_INSTRUMENTATION
+    led_cycle_counter_fn_t cycle_counter; /**Times the updates, NULL if not timing. */
+    uint32_t cycle_budget;              /**Updates longer than this are overruns, 0 for no budget. */
+    uint32_t update_start;              /**Cycle count at the start of the current update. */
+    led_stats_t stats;                  /**Timing of the updates so far. */
+#endif
+
+#ifdef LED_TRACE
+    led_trace_entry_t trace[LED_TRACE_SIZE]; /**The last transitions made by the updates. */
+    uint32_t trace_count;               /**Number of transitions recorded since init. */
+    uint8_t trace_state[LEDS_MAX];      /**Last state the updates wrote to each LED. */
+#endif
+}led_ctx_t;
+
 /**
  * @brief The inialisation for the led driver. Initialization the state of all of the LEDs in the LED array and creates
  * some special sequences like on and off.
@@ -64,7 +258,7 @@ void write(pins_t, led_state_t);
 void led_init(uint32_t callback_frequency);
 
 /**
- * @brief Return the number of registered LEDs in the led module.
+ * @brief Return the number of registered LEDs in the led module, not counting unregistered ones.
  * 
  * @returns uint16 - the number of registered LEDs.
  * 
@@ -86,7 +280,9 @@ void led_on(int32_t id);
 void led_off(int32_t id);
 
 /**
- * @brief Register an LED and its configurations with the LED module.
+ * @brief Register an LED and its configurations with the LED module. The slot of an unregistered LED 
+ * is reused before a new one, the ID then carries the slot's generation (see HANDLE_MAKE()) so the old
+ * LED's ID stays invalid. The mask functions address slots, bit n is the LED with HANDLE_SLOT(id) n.
  * 
  * @param [in] led_obj - a structure of type led_t that has the configurations for the LED
  * 
@@ -94,6 +290,16 @@ void led_off(int32_t id);
  */
 int32_t led_register(led_t led_obj);
 
+/**
+ * @brief Removes an LED, its slot is reused by the next registration. The pin isn't written, turn the
+ * LED off first if it should be left dark. Its ID is rejected by every function from now on.
+ * 
+ * @param [in] led_id - the LED to remove.
+ * 
+ * @return led_status_t - LED_ERR if the ID isn't a registered LED.
+ */
+led_status_t led_unregister(int32_t led_id);
+
 /**
  * @brief User defined function that turns led's on and off 
  * 
@@ -116,6 +322,42 @@ void led_disable(int32_t id);
 */
 void led_enable(int32_t id);
 
+/**
+ * @brief Checks if the selected LED is enabled.
+ *
+ * @param [in] id - ID of LED to check
+ * 
+ * @return bool - True if the LED is registered and enabled.
+*/
+bool led_is_enabled(int32_t id);
+
+/**
+ * @brief Enables every registered LED in a mask. Bit n of the mask is LED (word * 64 + n).
+ * Enabled LEDs have their state written on the next update.
+ *
+ * @param [in] word - which 64 LED word of the mask to apply to, 0 for LEDs 0 to 63
+ * @param [in] mask - the LEDs to be enabled
+*/
+void led_enable_mask(uint32_t word, uint64_t mask);
+
+/**
+ * @brief Disables every LED in a mask. Bit n of the mask is LED (word * 64 + n).
+ * Disabled LEDs are skipped by led_update_state() and hold their place in their sequence.
+ *
+ * @param [in] word - which 64 LED word of the mask to apply to, 0 for LEDs 0 to 63
+ * @param [in] mask - the LEDs to be disabled
+*/
+void led_disable_mask(uint32_t word, uint64_t mask);
+
+/**
+ * @brief Returns the enabled LEDs as a mask. Bit n of the mask is LED (word * 64 + n).
+ *
+ * @param [in] word - which 64 LED word of the mask to return, 0 for LEDs 0 to 63
+ * 
+ * @return uint64_t - mask of enabled LEDs, 0 if word is out of range.
+*/
+uint64_t led_get_enabled_mask(uint32_t word);
+
 /**
  * @brief Assigns a sequence to an LED
  *
@@ -126,6 +368,21 @@ void led_enable(int32_t id);
 */
 led_status_t led_assign_sequence(int32_t led_id, int32_t sequence_id);
 
+/**
+ * @brief Assigns a sequence to an LED that plays a set number of times and then moves on to another 
+ * sequence, e.g. blink 3 times then stay on, without the application having to reassign it. The next
+ * sequence starts from its first state on the step the last play would have wrapped, and loops forever.
+ * With no next sequence the LED holds the last state of the sequence and needs no more updates.
+ *
+ * @param [in] led_id - the id of the led to be assigned to 
+ * @param [in] sequence_id - the id of the sequence to be assinged to the led 
+ * @param [in] repeats - number of times the sequence plays, 0 to loop forever like led_assign_sequence().
+ * @param [in] next_sequence_id - the id of the sequence to move on to, -1 to hold the last state.
+ * 
+ * @return led_status_t - err if the led or either sequence doesn't exist.
+*/
+led_status_t led_assign_sequence_repeat(int32_t led_id, int32_t sequence_id, uint16_t repeats, int32_t next_sequence_id);
+
 /**
  * @brief Returns the current sequence assinged to that led, returns -1 if there is no sequence assigned 
  *
@@ -135,6 +392,32 @@ led_status_t led_assign_sequence(int32_t led_id, int32_t sequence_id);
 */
 int32_t led_get_sequence_id(int32_t led_id);
 
+/**
+ * @brief Assigns a sequence to every LED in a mask. Bit n of the mask is LED (word * 64 + n).
+ *
+ * @param [in] word - which 64 LED word of the mask to apply to, 0 for LEDs 0 to 63
+ * @param [in] mask - the LEDs to be assigned to 
+ * @param [in] sequence_id - the id of the sequence to be assinged to the leds 
+ * 
+ * @return led_status_t - err if any led in the mask or the sequence doesn't exist, nothing is assigned.
+*/
+led_status_t led_assign_sequence_mask(uint32_t word, uint64_t mask, int32_t sequence_id);
+
+/**
+ * @brief Replaces the content of a registered sequence, safe to call while led_update_state() runs in 
+ * the timer interrupt. The new content is built in a spare buffer now and published at the start of the
+ * next update, which switches the LEDs over in the same place the queued commands are applied. LEDs 
+ * showing the sequence keep their position and timing and show the new states from their next step.
+ * LEDs that have nothing left to step, a single state or a finished sequence, are written again with the
+ * new content by that update.
+ * 
+ * @param sequence_id - the sequence to replace.
+ * @param sequence - the new content.
+ * @return led_status_t - LED_ERR if the sequence doesn't exist, the last update of it hasn't been applied
+ * yet, no spare buffer was free or the command queue is full. Try again after the next update.
+ */
+led_status_t led_update_sequence(int32_t sequence_id, sequence_t sequence);
+
 /**
  * @brief Checks if a led is registered.
  * 
@@ -152,10 +435,129 @@ led_status_t led_start_sequence(int32_t led_id);
 
 /**
  * @brief Is called whenever you want to update the state of your LEDs
- * according to their sequence. Will update all LEDs.
+ * according to their sequence. Only enabled LEDs with an animated sequence (length > 1) or a 
+ * pending write are visited; static LEDs (e.g. led_turn_on()/led_turn_off()) are written 
+ * once on the next update after assignment or enabling and then left alone.
  */
 void led_update_state();
 
+/**
+ * @brief Alternative to led_update_state() for when the time spent per call has to be bounded. Call it
+ * in place of led_update_state() on every timer period. Each call services at most max_leds LEDs: 
+ * priority LEDs (see led_set_priority()) first, then the others round robin, resuming where the last 
+ * call left off. LEDs that aren't reached catch up on the time they missed when they are next serviced.
+ * 
+ * Only the servicing is budgeted. The work every update does first isn't counted against max_leds and
+ * runs in full: applying the queued commands, up to LED_COMMAND_QUEUE_SIZE of them, a scene due to be
+ * applied, which assigns to every LED in it, and taking down expired overlays. Bound it with the size of
+ * the queue and by not applying large scenes where the update has to be short.
+ * 
+ * @param max_leds - the most LEDs to service in this call.
+ */
+void led_update_state_budget(uint32_t max_leds);
+
+/**
+ * @brief Alternative to led_update_state() for tickless builds, call it when the timer set from 
+ * led_get_next_wakeup() fires. Advances every LED by the time that has passed and writes the LEDs 
+ * whose next step has come due, in a single pass.
+ * 
+ * @param elapsed_ms - time in ms since the last update.
+ */
+void led_update_elapsed(uint32_t elapsed_ms);
+
+/**
+ * @brief Returns how long a tickless build can sleep before calling led_update_elapsed(). Transitions 
+ * that are within their LED's tolerance (see led_set_tolerance()) of this wakeup are delayed to share it,
+ * rather than each getting a wakeup of their own. Commands queued or scenes activated while asleep 
+ * are only applied on the next wakeup.
+ * 
+ * @return uint32_t - ms until the next wakeup, UINT32_MAX if no LED has anything scheduled.
+ */
+uint32_t led_get_next_wakeup();
+
+/**
+ * @brief Sets how late an LED's transitions may be written so they can be batched with other LEDs 
+ * in a single wakeup by led_get_next_wakeup(). Defaults to 0, on time.
+ * 
+ * @param led_id - unique identifier of the target led.
+ * @param tolerance - the most a transition may be delayed by in ms.
+ */
+void led_set_tolerance(int32_t led_id, uint16_t tolerance);
+
+/**
+ * @brief Sets whether an LED is serviced ahead of the others by led_update_state_budget(), e.g. for 
+ * status and fault LEDs that must never lag.
+ * 
+ * @param led_id - unique identifier of the target led.
+ * @param high_priority - true to service the LED first.
+ */
+void led_set_priority(int32_t led_id, bool high_priority);
+
+/**
+ * @brief Checks if an LED is serviced ahead of the others by led_update_state_budget().
+ * 
+ * @param led_id - unique identifier of the target led.
+ * @return bool - true if the LED is high priority.
+ */
+bool led_is_priority(int32_t led_id);
+
+/**
+ * @brief Sets how often an LED is evaluated. With a divisor of N the LED is only serviced on every Nth 
+ * update, catching up on the time in between, so slow patterns cost less per update. LEDs are spread 
+ * over the N updates by ID so they don't all land on the same one.
+ * 
+ * @param led_id - unique identifier of the target led.
+ * @param divisor - service the LED every divisor updates, 0 or 1 for every update.
+ */
+void led_set_rate_divisor(int32_t led_id, uint16_t divisor);
+
+/**
+ * @brief Sets the rate divisor (see led_set_rate_divisor()) of every registered LED in a mask. The LEDs
+ * in the group are dealt out over the divisor updates in turn to level the load.
+ * 
+ * @param word - which 64 LED word of the mask to apply to, 0 for LEDs 0 to 63
+ * @param mask - the LEDs in the group. Bit n of the mask is LED (word * 64 + n).
+ * @param divisor - service the LEDs every divisor updates, 0 or 1 for every update.
+ */
+void led_set_rate_divisor_mask(uint32_t word, uint64_t mask, uint16_t divisor);
+
+/**
+ * @brief Returns the rate divisor of an LED.
+ * 
+ * @param led_id - unique identifier of the target led.
+ * @return uint16_t - the divisor, 0 if the LED doesn't exist.
+ */
+uint16_t led_get_rate_divisor(int32_t led_id);
+
+/**
+ * @brief Sets how fast an LED plays its sequence, so one sequence can be shown at any speed without 
+ * registering a copy with a different period. The rate is fixed point with 8 fractional bits, 
+ * LED_RATE_1X (256) is normal speed, 128 half speed and 512 double. 0 freezes the sequence. A sequence
+ * still moves at most one step per update however fast it's played. The rate belongs to the LED and
+ * stays when a new sequence is assigned.
+ * 
+ * @param led_id - unique identifier of the target led.
+ * @param rate - the playback rate.
+ */
+void led_set_playback_rate(int32_t led_id, uint16_t rate);
+
+/**
+ * @brief Sets the playback rate (see led_set_playback_rate()) of every registered LED in a mask.
+ * 
+ * @param word - which 64 LED word of the mask to apply to, 0 for LEDs 0 to 63
+ * @param mask - the LEDs in the group. Bit n of the mask is LED (word * 64 + n).
+ * @param rate - the playback rate.
+ */
+void led_set_playback_rate_mask(uint32_t word, uint64_t mask, uint16_t rate);
+
+/**
+ * @brief Returns the playback rate of an LED.
+ * 
+ * @param led_id - unique identifier of the target led.
+ * @return uint16_t - the rate, 0 if the LED doesn't exist.
+ */
+uint16_t led_get_playback_rate(int32_t led_id);
+
 /**
  * @brief Turns on the specified LED
  * 
@@ -171,7 +573,8 @@ void led_turn_on(int32_t led_id);
 void led_turn_off(int32_t led_id);
 
 /**
- * @brief Returns the led if registed based off the inputted id
+ * @brief Returns the led if registed based off the inputted id. The returned object is the driver's
+ * live state, use led_read_snapshot() to read it from a different task or thread than led_update_state().
  * 
  * @param sequence_id - index of the led in the list of sequences.
  * 
@@ -188,4 +591,414 @@ void led_turn_off(int32_t led_id);
 void led_offset_sequence(uint32_t led_id, uint8_t seq_offset);
 
 
-#endif
\ No newline at end of file
+/**
+ * @brief Queues a sequence assignment to be applied at the start of the next led_update_state().
+ * Unlike led_assign_sequence() this is safe to call from any task or interrupt while 
+ * led_update_state() runs in the timer interrupt, without masking interrupts. Never blocks.
+ *
+ * @param [in] led_id - the id of the led to be assigned to 
+ * @param [in] sequence_id - the id of the sequence to be assinged to the led 
+ * 
+ * @return led_status_t - err if the led or sequence doesn't exist or the queue is full.
+*/
+led_status_t led_queue_assign_sequence(int32_t led_id, int32_t sequence_id);
+
+/**
+ * @brief Queues led_enable() to be applied at the start of the next led_update_state().
+ *
+ * @param [in] led_id - ID of LED to be enabled 
+ * 
+ * @return led_status_t - err if the led doesn't exist or the queue is full.
+*/
+led_status_t led_queue_enable(int32_t led_id);
+
+/**
+ * @brief Queues led_disable() to be applied at the start of the next led_update_state().
+ *
+ * @param [in] led_id - ID of LED to be disabled 
+ * 
+ * @return led_status_t - err if the led doesn't exist or the queue is full.
+*/
+led_status_t led_queue_disable(int32_t led_id);
+
+/**
+ * @brief Queues led_offset_sequence() to be applied at the start of the next led_update_state().
+ *
+ * @param [in] led_id - unique identifier of the target led.
+ * @param [in] seq_offset - amout to offset the sequence_idx in the led's structure
+ * 
+ * @return led_status_t - err if the led doesn't exist or the queue is full.
+*/
+led_status_t led_queue_offset_sequence(int32_t led_id, uint8_t seq_offset);
+
+/**
+ * @brief Copies the state of an LED without blocking led_update_state(). If an update or other state 
+ * change happens during the copy, the copy is retried up to LED_SNAPSHOT_RETRIES times.
+ * Safe to call from any task or thread.
+ *
+ * @param [in] led_id - unique identifier of the target led.
+ * @param [out] out - where the copy of the LED is written.
+ * 
+ * @return led_status_t - err if the led doesn't exist or every attempt raced with a state change.
+*/
+led_status_t led_read_snapshot(int32_t led_id, led_t * out);
+
+/**
+ * @brief Copies the state of every registered LED, as of a single point in time, without blocking 
+ * led_update_state(). Retried like led_read_snapshot().
+ *
+ * @param [out] out - array the LEDs are copied into, indexed by slot, HANDLE_SLOT() of the LED's ID.
+ * Slots freed by led_unregister() are copied with sequence_id LED_SLOT_FREE.
+ * @param [in] max - number of elements in out.
+ * 
+ * @return int32_t - the number of slots copied, -1 if every attempt raced with a state change.
+*/
+int32_t led_read_table(led_t * out, uint32_t max);
+
+#ifdef LED_OVERLAYS
+/**
+ * @brief Shows a sequence on an LED over its assigned sequence for a while, e.g. a notification. The 
+ * overlays of an LED form a small stack ordered by priority, the highest is shown, and a new overlay 
+ * goes above others of the same priority. An overlay starts from its first state each time it comes 
+ * to the top. When the last overlay is removed the assigned sequence carries on from where it would 
+ * have been had it never been covered. Assigning or offsetting a sequence while overlays are shown
+ * changes the assigned sequence underneath them. Only available when built with LED_OVERLAYS, without
+ * it the overlay stacks take no memory in the context.
+ *
+ * @param [in] led_id - unique identifier of the target led.
+ * @param [in] sequence_id - the sequence to show.
+ * @param [in] priority - higher priorities cover lower ones.
+ * @param [in] duration_ms - how long the overlay stays, 0 to stay until led_pop_overlay().
+ * 
+ * @return led_status_t - err if the led or sequence doesn't exist or the LED already has 
+ * LED_OVERLAY_DEPTH overlays.
+*/
+led_status_t led_push_overlay(int32_t led_id, int32_t sequence_id, uint8_t priority, uint32_t duration_ms);
+
+/**
+ * @brief Removes the overlay being shown on an LED, the one below it or the assigned sequence is shown.
+ *
+ * @param [in] led_id - unique identifier of the target led.
+ * 
+ * @return led_status_t - err if the led doesn't exist or has no overlays.
+*/
+led_status_t led_pop_overlay(int32_t led_id);
+
+/**
+ * @brief Removes every overlay from an LED and goes back to its assigned sequence.
+ *
+ * @param [in] led_id - unique identifier of the target led.
+*/
+void led_clear_overlays(int32_t led_id);
+
+/**
+ * @brief Return the number of overlays on an LED, 0 if it doesn't exist.
+*/
+uint32_t led_get_overlay_count(int32_t led_id);
+#endif
+
+/**
+ * @brief Starts recording LED events in the update so they can be handled outside the interrupt. The 
+ * update only sets a bit per LED and event, so an LED that cycles several times before the next 
+ * dispatch is reported once.
+ * 
+ * @param [in] callback - handles the events in led_dispatch_events(), NULL to stop recording.
+*/
+void led_set_event_callback(led_event_fn_t callback);
+
+/**
+ * @brief Passes the events recorded since the last call to the callback, one call per event type and 
+ * 64 LED word that had any. Call from the main loop or a task, not the timer interrupt. Safe to 
+ * run while an update is in progress, events it records are picked up by the next dispatch.
+ * 
+ * @return uint32_t - the number of times the callback was called.
+*/
+uint32_t led_dispatch_events();
+
+#ifdef LED_INSTRUMENTATION
+/**
+ * @brief Starts timing every update with a cycle counter. Only available when built with 
+ * LED_INSTRUMENTATION, without it no timing code is compiled into the updates.
+ * 
+ * @param [in] counter - free running counter read at the start and end of each update, NULL to stop timing.
+ * @param [in] budget - the most cycles an update should take, longer ones count as overruns. 0 for no budget.
+*/
+void led_set_cycle_counter(led_cycle_counter_fn_t counter, uint32_t budget);
+
+/**
+ * @brief Reads the update timing collected since the counter was set or the stats were reset. Safe
+ * to call while the update runs in an interrupt.
+ * 
+ * @param [out] out - filled in with the timing.
+ * @return led_status_t - Err if the update kept changing the stats during the read.
+*/
+led_status_t led_get_stats(led_stats_t * out);
+
+/**
+ * @brief Clears the update timing.
+*/
+void led_reset_stats();
+#endif
+
+#ifdef LED_TRACE
+/**
+ * @brief Copies the transitions recorded by the trace, oldest first. Every time an update writes an LED 
+ * a different state to the one it last wrote, the change is recorded in a ring of LED_TRACE_SIZE 
+ * entries, the oldest are overwritten. Only available when built with LED_TRACE. Retried like 
+ * led_read_snapshot().
+ *
+ * @param [out] out - array the transitions are copied into.
+ * @param [in] max - number of elements in out.
+ * 
+ * @return int32_t - the number of transitions copied, -1 if every attempt raced with a state change.
+*/
+int32_t led_read_trace(led_trace_entry_t * out, uint32_t max);
+
+/**
+ * @brief Return the number of transitions recorded since init or the last clear, including the ones
+ * that have since been overwritten.
+*/
+uint32_t led_get_trace_count();
+
+/**
+ * @brief Empties the trace.
+*/
+void led_clear_trace();
+#endif
+
+/***************/
+/* CONTEXT API */
+/***************/
+
+/**
+ * @brief Returns the context used by the led_* functions without a context.
+ * 
+ * @return led_ctx_t * - the default context.
+ */
+led_ctx_t * led_get_default_ctx();
+
+/**
+ * @brief Context version of led_init(). Initialises the sequence table the context uses and registers 
+ * the on and off sequences in it, so give each context its own table. Output goes to write() until 
+ * changed with led_ctx_set_write().
+ * 
+ * @param [in] ctx - the context to initialise.
+ * @param [in] sequences - the sequence table used by the context.
+ * @param [in] timer_period - How often the context's update will be called in milliseconds.
+*/
+void led_ctx_init(led_ctx_t * ctx, sequence_ctx_t * sequences, uint32_t timer_period);
+
+/**
+ * @brief Sets the function the context writes LED states with, e.g. to drive each bank from its own 
+ * peripheral.
+ * 
+ * @param [in] ctx - the context.
+ * @param [in] write_fn - the function to write with.
+*/
+void led_ctx_set_write(led_ctx_t * ctx, led_write_fn_t write_fn);
+
+#ifdef LED_BATCH
+/**
+ * @brief Chooses whether the context's updates step LEDs with the vectorised batch kernel in 
+ * led_batch.h. LEDs that can't be batched, e.g. ones catching up on missed updates, are still 
+ * stepped one at a time, the written states are the same either way. Off by default.
+ * 
+ * @param [in] ctx - the context.
+ * @param [in] enabled - true to use the batch kernel.
+*/
+void led_ctx_set_batch_update(led_ctx_t * ctx, bool enabled);
+#endif
+
+/** @brief Context version of led_get_count(). */
+uint32_t led_ctx_get_count(led_ctx_t * ctx);
+
+/** @brief Context version of led_on(). */
+void led_ctx_on(led_ctx_t * ctx, int32_t id);
+
+/** @brief Context version of led_off(). */
+void led_ctx_off(led_ctx_t * ctx, int32_t id);
+
+/** @brief Context version of led_register(). */
+int32_t led_ctx_register(led_ctx_t * ctx, led_t led_obj);
+
+/** @brief Context version of led_unregister(). */
+led_status_t led_ctx_unregister(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_disable(). */
+void led_ctx_disable(led_ctx_t * ctx, int32_t id);
+
+/** @brief Context version of led_enable(). */
+void led_ctx_enable(led_ctx_t * ctx, int32_t id);
+
+/** @brief Context version of led_is_enabled(). */
+bool led_ctx_is_enabled(led_ctx_t * ctx, int32_t id);
+
+/** @brief Context version of led_enable_mask(). */
+void led_ctx_enable_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask);
+
+/** @brief Context version of led_disable_mask(). */
+void led_ctx_disable_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask);
+
+/** @brief Context version of led_get_enabled_mask(). */
+uint64_t led_ctx_get_enabled_mask(led_ctx_t * ctx, uint32_t word);
+
+/** @brief Context version of led_assign_sequence(). */
+led_status_t led_ctx_assign_sequence(led_ctx_t * ctx, int32_t led_id, int32_t sequence_id);
+
+/** @brief Context version of led_assign_sequence_repeat(). */
+led_status_t led_ctx_assign_sequence_repeat(led_ctx_t * ctx, int32_t led_id, int32_t sequence_id, uint16_t repeats, int32_t next_sequence_id);
+
+/** @brief Context version of led_get_sequence_id(). */
+int32_t led_ctx_get_sequence_id(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_assign_sequence_mask(). */
+led_status_t led_ctx_assign_sequence_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask, int32_t sequence_id);
+
+/** @brief Context version of led_update_sequence(). */
+led_status_t led_ctx_update_sequence(led_ctx_t * ctx, int32_t sequence_id, sequence_t sequence);
+
+/** @brief Context version of led_exists(). */
+bool led_ctx_exists(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_update_state(). */
+void led_ctx_update_state(led_ctx_t * ctx);
+
+/**
+ * @brief First part of an update split into led_ctx_update_begin(), led_ctx_update_words() and
+ * led_ctx_update_end(), so that the LEDs can be updated in parts, e.g. by several threads. Applies 
+ * scenes and queued commands and advances the clock by one timer period.
+ * 
+ * @param [in] ctx - the context.
+*/
+void led_ctx_update_begin(led_ctx_t * ctx);
+
+/**
+ * @brief Updates the LEDs of a range of mask words (64 LEDs per word), as led_update_state() would.
+ * Calls for different words don't share any state, so they can run at the same time as long as 
+ * nothing else changes the context until led_ctx_update_end().
+ * 
+ * @param [in] ctx - the context.
+ * @param [in] first_word - the first mask word to update.
+ * @param [in] words - the number of mask words to update.
+ * @param [out] out - if NULL the states are written as they are found. Otherwise the states are 
+ * stored here in LED order for the caller to write, which needs space for 64 per word.
+ * @return uint32_t - the number of states written or stored.
+*/
+uint32_t led_ctx_update_words(led_ctx_t * ctx, uint32_t first_word, uint32_t words, led_output_t * out);
+
+/**
+ * @brief Completes an update started by led_ctx_update_begin().
+ * 
+ * @param [in] ctx - the context.
+*/
+void led_ctx_update_end(led_ctx_t * ctx);
+
+/** @brief Context version of led_update_state_budget(). */
+void led_ctx_update_state_budget(led_ctx_t * ctx, uint32_t max_leds);
+
+/** @brief Context version of led_update_elapsed(). */
+void led_ctx_update_elapsed(led_ctx_t * ctx, uint32_t elapsed_ms);
+
+/** @brief Context version of led_get_next_wakeup(). */
+uint32_t led_ctx_get_next_wakeup(led_ctx_t * ctx);
+
+/** @brief Context version of led_set_tolerance(). */
+void led_ctx_set_tolerance(led_ctx_t * ctx, int32_t led_id, uint16_t tolerance);
+
+/** @brief Context version of led_set_priority(). */
+void led_ctx_set_priority(led_ctx_t * ctx, int32_t led_id, bool high_priority);
+
+/** @brief Context version of led_is_priority(). */
+bool led_ctx_is_priority(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_set_rate_divisor(). */
+void led_ctx_set_rate_divisor(led_ctx_t * ctx, int32_t led_id, uint16_t divisor);
+
+/** @brief Context version of led_set_rate_divisor_mask(). */
+void led_ctx_set_rate_divisor_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask, uint16_t divisor);
+
+/** @brief Context version of led_get_rate_divisor(). */
+uint16_t led_ctx_get_rate_divisor(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_set_playback_rate(). */
+void led_ctx_set_playback_rate(led_ctx_t * ctx, int32_t led_id, uint16_t rate);
+
+/** @brief Context version of led_set_playback_rate_mask(). */
+void led_ctx_set_playback_rate_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask, uint16_t rate);
+
+/** @brief Context version of led_get_playback_rate(). */
+uint16_t led_ctx_get_playback_rate(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_turn_on(). */
+void led_ctx_turn_on(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_turn_off(). */
+void led_ctx_turn_off(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_get_from_id(). */
+led_t * led_ctx_get_from_id(led_ctx_t * ctx, uint32_t led_id);
+
+/** @brief Context version of led_offset_sequence(). */
+void led_ctx_offset_sequence(led_ctx_t * ctx, uint32_t led_id, uint8_t seq_offset);
+
+/** @brief Context version of led_queue_assign_sequence(). */
+led_status_t led_ctx_queue_assign_sequence(led_ctx_t * ctx, int32_t led_id, int32_t sequence_id);
+
+/** @brief Context version of led_queue_enable(). */
+led_status_t led_ctx_queue_enable(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_queue_disable(). */
+led_status_t led_ctx_queue_disable(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_queue_offset_sequence(). */
+led_status_t led_ctx_queue_offset_sequence(led_ctx_t * ctx, int32_t led_id, uint8_t seq_offset);
+
+/** @brief Context version of led_read_snapshot(). */
+led_status_t led_ctx_read_snapshot(led_ctx_t * ctx, int32_t led_id, led_t * out);
+
+/** @brief Context version of led_read_table(). */
+int32_t led_ctx_read_table(led_ctx_t * ctx, led_t * out, uint32_t max);
+
+#ifdef LED_OVERLAYS
+/** @brief Context version of led_push_overlay(). */
+led_status_t led_ctx_push_overlay(led_ctx_t * ctx, int32_t led_id, int32_t sequence_id, uint8_t priority, uint32_t duration_ms);
+
+/** @brief Context version of led_pop_overlay(). */
+led_status_t led_ctx_pop_overlay(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_clear_overlays(). */
+void led_ctx_clear_overlays(led_ctx_t * ctx, int32_t led_id);
+
+/** @brief Context version of led_get_overlay_count(). */
+uint32_t led_ctx_get_overlay_count(led_ctx_t * ctx, int32_t led_id);
+#endif
+
+/** @brief Context version of led_set_event_callback(). */
+void led_ctx_set_event_callback(led_ctx_t * ctx, led_event_fn_t callback);
+
+/** @brief Context version of led_dispatch_events(). */
+uint32_t led_ctx_dispatch_events(led_ctx_t * ctx);
+
+#ifdef LED_INSTRUMENTATION
+/** @brief Context version of led_set_cycle_counter(). */
+void led_ctx_set_cycle_counter(led_ctx_t * ctx, led_cycle_counter_fn_t counter, uint32_t budget);
+
+/** @brief Context version of led_get_stats(). */
+led_status_t led_ctx_get_stats(led_ctx_t * ctx, led_stats_t * out);
+
+/** @brief Context version of led_reset_stats(). */
+void led_ctx_reset_stats(led_ctx_t * ctx);
+#endif
+
+#ifdef LED_TRACE
+/** @brief Context version of led_read_trace(). */
+int32_t led_ctx_read_trace(led_ctx_t * ctx, led_trace_entry_t * out, uint32_t max);
+
+/** @brief Context version of led_get_trace_count(). */
+uint32_t led_ctx_get_trace_count(led_ctx_t * ctx);
+
+/** @brief Context version of led_clear_trace(). */
+void led_ctx_clear_trace(led_ctx_t * ctx);
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @file led_batch.h
+ * @brief Vectorised sequence stepping for host builds driving very large numbers of LEDs. LEDs that are
+ * stepped every update are copied into a struct of arrays and advanced several at a time with AVX2 or
+ * SSE2 when the compiler targets them, otherwise one at a time. The results are bit for bit the same as
+ * led_update_state(). Only built when LED_BATCH is defined.
+ */
+
+#ifndef LED_BATCH_H
+#define LED_BATCH_H
+
+#include "led.h"
+
+#ifdef LED_BATCH
+
+/** Most LEDs in a batch, one mask word. */
+#define LED_BATCH_MAX 64
+
+/**
+ * @brief The LEDs of a batch as a struct of arrays, so each field of neighbouring LEDs can be loaded
+ * into a vector register at once.
+ */
+typedef struct{
+    uint32_t timer_count[LED_BATCH_MAX]; /**Time in ms towards the LED's next step. */
+    uint32_t step_ms[LED_BATCH_MAX];     /**Duration of one step of the LED's sequence. */
+    uint32_t idx[LED_BATCH_MAX];         /**Position in the sequence, must be less than the length. */
+    uint32_t length[LED_BATCH_MAX];      /**Length of the LED's sequence. */
+    uint32_t seq_offset[LED_BATCH_MAX];  /**Byte offset of the LED's sequence states in the table. */
+    uint32_t state[LED_BATCH_MAX];       /**Output, the state the LED is written with. */
+    uint32_t count;                      /**Number of LEDs in the batch. */
+}led_batch_t;
+
+/**
+ * @brief Advances every LED in the batch by the elapsed time, at most one step each, and gathers the
+ * state each LED is now at from the table. Uses the widest instructions the build targets.
+ *
+ * @param [in,out] batch - the LEDs to advance.
+ * @param [in] elapsed - time in ms since the LEDs were last advanced.
+ * @param [in] table - the sequence states the offsets refer to. Up to 3 bytes past an LED's last state
+ * are read, so each sequence must be followed by 3 more bytes of the table.
+*/
+void led_batch_advance(led_batch_t * batch, uint32_t elapsed, const uint8_t * table);
+
+/**
+ * @brief Does the same as led_batch_advance() one LED at a time. Used for the LEDs left over after the
+ * vector instructions and by builds without them.
+ *
+ * @param [in,out] batch - the LEDs to advance.
+ * @param [in] first - the first LED to advance.
+ * @param [in] elapsed - time in ms since the LEDs were last advanced.
+ * @param [in] table - the sequence states the offsets refer to.
+*/
+void led_batch_advance_scalar(led_batch_t * batch, uint32_t first, uint32_t elapsed, const uint8_t * table);
+
+#endif
+
+#endif
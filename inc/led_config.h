@@ -0,0 +1,103 @@
+/**
+ * @file led_config.h
+ * @brief Every build option of the driver in one place. The sizes and features set here change the
+ * layout of led_ctx_t, sequence_ctx_t and the other context structs the application allocates, so
+ * every file that includes the driver's headers, the driver's own sources and any prebuilt library
+ * must see the same values. Set them for the project in led_user_config.h, which is found on the
+ * include path like user_led.h, rather than with -D on individual files. Options left out of it get
+ * the defaults below.
+ */
+
+#ifndef LED_CONFIG_H
+#define LED_CONFIG_H
+
+#include "led_user_config.h"
+
+/*********/
+/* SIZES */
+/*********/
+
+/** Number of LEDs a context holds. Most of led_ctx_t is kept per LED, so size it to the board. */
+#ifndef LEDS_MAX
+#define LEDS_MAX 64
+#endif
+
+/** Number of sequences a table holds, each takes a buffer of MAX_SEQUENCE steps. */
+#ifndef MAX_SEQUENCES
+#define MAX_SEQUENCES 64
+#endif
+
+/** Most steps in one sequence, the steps are indexed with a uint8_t. */
+#ifndef MAX_SEQUENCE
+#define MAX_SEQUENCE 100
+#endif
+
+/**
+ * Buffers kept beyond one per sequence. A new version of a sequence is built in a spare buffer while
+ * updates may still be reading the old one, which only becomes spare again once no update is reading.
+ */
+#ifndef SEQUENCE_SPARE_BUFFERS
+#define SEQUENCE_SPARE_BUFFERS 4
+#endif
+
+/** Number of commands that can be waiting for the next led_update_state(). Must be a power of two. */
+#ifndef LED_COMMAND_QUEUE_SIZE
+#define LED_COMMAND_QUEUE_SIZE 32
+#endif
+
+/** Number of times a snapshot read is retried when it races with an update before giving up. */
+#ifndef LED_SNAPSHOT_RETRIES
+#define LED_SNAPSHOT_RETRIES 16
+#endif
+
+/** Number of overlays that can be stacked on one LED when built with LED_OVERLAYS, see led_push_overlay(). */
+#ifndef LED_OVERLAY_DEPTH
+#define LED_OVERLAY_DEPTH 2
+#endif
+
+/** Number of transitions kept by the trace when built with LED_TRACE. Must be a power of two. */
+#ifndef LED_TRACE_SIZE
+#define LED_TRACE_SIZE 256
+#endif
+
+/** Number of scenes a scene table holds, see scene.h. */
+#ifndef MAX_SCENES
+#define MAX_SCENES 16
+#endif
+
+/** Number of streams that can play at once, see led_stream.h. */
+#ifndef MAX_STREAMS
+#define MAX_STREAMS 4
+#endif
+
+/************/
+/* FEATURES */
+/************/
+
+/*
+ * Optional features are compiled in when their macro is defined, in led_user_config.h:
+ *
+ * LED_OVERLAYS        - sequences shown over an LED's own for a while, see led_push_overlay().
+ * LED_TRACE           - a ring of the transitions made by the updates, see led_read_trace().
+ * LED_INSTRUMENTATION - cycle counts of the updates, see led_set_cycle_counter().
+ * LED_BATCH           - vectorised stepping for host builds, see led_batch.h.
+ * LED_PARALLEL        - updates split over a thread pool for host builds, see led_parallel.h.
+ */
+
+/**********/
+/* CHECKS */
+/**********/
+
+#if MAX_SEQUENCE > 256
+#error "MAX_SEQUENCE must fit in the uint8_t step index of an LED"
+#endif
+
+#if (LED_COMMAND_QUEUE_SIZE & (LED_COMMAND_QUEUE_SIZE - 1)) != 0
+#error "LED_COMMAND_QUEUE_SIZE must be a power of two"
+#endif
+
+#if (LED_TRACE_SIZE & (LED_TRACE_SIZE - 1)) != 0
+#error "LED_TRACE_SIZE must be a power of two"
+#endif
+
+#endif
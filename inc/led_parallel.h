@@ -0,0 +1,77 @@
+/**
+ * @file led_parallel.h
+ * @brief Thread pool update for host builds driving very large numbers of LEDs. The LED table is split
+ * into chunks of mask words that the threads claim in turn, each chunk's states are kept in its own part
+ * of an output buffer and written in LED order once every chunk is done, so the result is identical to
+ * led_update_state(). Only built when LED_PARALLEL is defined, needs pthreads.
+ */
+
+#ifndef LED_PARALLEL_H
+#define LED_PARALLEL_H
+
+#include "led.h"
+
+#ifdef LED_PARALLEL
+
+#include <pthread.h>
+
+/** Most worker threads a pool can have. */
+#ifndef LED_PARALLEL_MAX_THREADS
+#define LED_PARALLEL_MAX_THREADS 16
+#endif
+
+/** Number of mask words (64 LEDs each) claimed by a thread at a time. */
+#ifndef LED_PARALLEL_CHUNK_WORDS
+#define LED_PARALLEL_CHUNK_WORDS 4
+#endif
+
+#define LED_PARALLEL_CHUNKS ((LED_MASK_WORDS + LED_PARALLEL_CHUNK_WORDS - 1) / LED_PARALLEL_CHUNK_WORDS)
+
+/**
+ * @brief A pool of worker threads that update contexts with led_ctx_update_state_parallel(). The fields
+ * are private to the module.
+ */
+typedef struct{
+    pthread_t threads[LED_PARALLEL_MAX_THREADS]; /**The worker threads. */
+    uint32_t thread_count;                       /**Number of worker threads. */
+    pthread_mutex_t lock;                        /**Guards the fields below up to next_chunk. */
+    pthread_cond_t start;                        /**Signalled when an update starts or the pool stops. */
+    pthread_cond_t done;                         /**Signalled when the last worker finishes an update. */
+    uint32_t generation;                         /**Incremented for each update. */
+    uint32_t running;                            /**Number of workers still on the current update. */
+    bool stopping;                               /**True once the pool is being destroyed. */
+    led_ctx_t * ctx;                             /**The context being updated. */
+    uint32_t next_chunk;                         /**Next chunk to be claimed, only accessed atomically. */
+    uint32_t chunk_outputs[LED_PARALLEL_CHUNKS]; /**Number of states each chunk stored. */
+    led_output_t outputs[LED_MASK_WORDS * 64];   /**The stored states, each chunk has the part for its LEDs. */
+}led_pool_t;
+
+/**
+ * @brief Starts a pool of worker threads.
+ *
+ * @param [in] pool - the pool to start.
+ * @param [in] threads - number of worker threads, the thread calling the update also does a share.
+ * 0 updates on the calling thread alone.
+ * @return led_status_t - err if there are too many threads or they couldn't be started.
+*/
+led_status_t led_pool_init(led_pool_t * pool, uint32_t threads);
+
+/**
+ * @brief Stops the pool's worker threads and waits for them to exit.
+ *
+ * @param [in] pool - the pool to stop.
+*/
+void led_pool_destroy(led_pool_t * pool);
+
+/**
+ * @brief Does the same as led_ctx_update_state(), sharing the LEDs out between the pool's threads. The
+ * states are written from the calling thread in the same order as led_ctx_update_state() writes them.
+ *
+ * @param [in] ctx - the context to update.
+ * @param [in] pool - the pool to update with, used for one update at a time.
+*/
+void led_ctx_update_state_parallel(led_ctx_t * ctx, led_pool_t * pool);
+
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file led_stream.h
+ * @brief Plays patterns too long to register as a sequence (recorded light shows, patterns generated
+ * from data). Each stream drives one LED with a sequence of its own that is used as a double buffer:
+ * the LED plays one half while led_stream_service(), called from the main loop rather than the timer
+ * interrupt, pulls the next states from the producer into the other half and publishes them with
+ * led_update_sequence(), which the next update applies. The LED's position is only read through
+ * led_read_snapshot(), so servicing the streams never races with the update. Memory use doesn't depend
+ * on the length of the pattern.
+ */
+
+#ifndef LED_STREAM_H
+#define LED_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "led.h"
+
+/** Most states in each half of a stream's buffer. */
+#define LED_STREAM_HALF_MAX (MAX_SEQUENCE / 2)
+
+/**
+ * @brief Produces the next states of a stream.
+ *
+ * @param stream_id - the stream asking for states.
+ * @param states - where the states (led_state_t) are written.
+ * @param count - number of states wanted.
+ * @return uint32_t - number of states written, fewer than count ends the stream.
+ */
+typedef uint32_t (*led_stream_fill_fn_t)(int32_t stream_id, uint8_t * states, uint32_t count);
+
+/**
+ * @brief Where a stream is in its pattern.
+ */
+typedef enum{
+    LED_STREAM_CLOSED,   /**Not open. */
+    LED_STREAM_PLAYING,  /**The producer is still being asked for states. */
+    LED_STREAM_DRAINING, /**The producer has ended the stream, the LED is playing the last states. */
+    LED_STREAM_FINISHED  /**Every state has been played, the LED holds the last one. */
+}led_stream_state_t;
+
+/**
+ * @brief One stream. The fields are private to the module.
+ */
+typedef struct{
+    led_stream_state_t state;  /**Where the stream is in its pattern. */
+    led_stream_fill_fn_t fill; /**Produces the states. */
+    int32_t led_id;            /**LED playing the stream. */
+    int32_t sequence_id;       /**The stream's own sequence, both halves of the buffer. */
+    sequence_t buffer;         /**Copy of the published content, the next version is built in it. */
+    uint8_t half;              /**Number of states in each half. */
+    uint8_t fill_half;         /**Half refilled once the LED has moved on from it. */
+    uint8_t end_half;          /**Half the producer ended the stream in. */
+    uint8_t end_idx;           /**Index after the producer's last state. */
+    uint8_t last_state;        /**Last state produced, shown once the stream has ended. */
+    bool unpublished;          /**True if the buffer holds states that haven't been published yet. */
+}led_stream_t;
+
+/**
+ * @brief The streams of one LED context. The fields are private to the module, use the
+ * led_stream_ctx_* functions.
+ */
+typedef struct{
+    led_stream_t streams[MAX_STREAMS]; /**The streams, open or not. */
+    led_ctx_t * led;                   /**The LED context the streams play on. */
+}led_stream_ctx_t;
+
+/**
+ * @brief Initialises the stream module on the default LED context, forgetting any open streams. Call 
+ * after led_init().
+ */
+void led_stream_init();
+
+/**
+ * @brief Opens a stream on an LED. Both halves of the buffer are filled by the producer straight away
+ * and the LED starts the stream from its first state, as if a sequence had been assigned to it.
+ *
+ * @param [in] led_id - LED that plays the stream.
+ * @param [in] half - number of states in each half of the buffer, up to LED_STREAM_HALF_MAX. The LED
+ * plays this many states between the refills, so led_stream_service() must be called at least that
+ * often or the LED repeats the old states of a half.
+ * @param [in] step_ms - time each state is shown for.
+ * @param [in] fill - produces the states.
+ *
+ * @return int32_t - the ID of the stream. -1 if the LED doesn't exist, the half is out of range, there
+ * is no free stream or no space for the stream's sequence.
+ */
+int32_t led_stream_open(int32_t led_id, uint8_t half, uint32_t step_ms, led_stream_fill_fn_t fill);
+
+/**
+ * @brief Refills the half of each stream's buffer the LED has moved on from and publishes it. Once a
+ * stream has ended and its last state has been shown the LED is left holding it as a static LED.
+ * Call regularly from the main loop, not from the timer interrupt. Streams whose LED has been given
+ * another sequence aren't refilled.
+ */
+void led_stream_service();
+
+/**
+ * @brief Returns where a stream is in its pattern.
+ *
+ * @param [in] stream_id - the stream.
+ *
+ * @return led_stream_state_t - LED_STREAM_CLOSED if the stream isn't open.
+ */
+led_stream_state_t led_stream_get_state(int32_t stream_id);
+
+/**
+ * @brief Closes a stream and frees its sequence. If the LED is still playing the stream it is turned off
+ * by the next update.
+ *
+ * @param [in] stream_id - the stream.
+ *
+ * @return led_status_t - err if the stream isn't open or the command queue is full, then the stream
+ * stays open.
+ */
+led_status_t led_stream_close(int32_t stream_id);
+
+/**
+ * @brief Returns the streams used by the led_stream_* functions without a context, on the default
+ * LED context.
+ *
+ * @return led_stream_ctx_t * - the default stream context.
+ */
+led_stream_ctx_t * led_stream_get_default_ctx();
+
+/**
+ * @brief Context version of led_stream_init().
+ *
+ * @param [in] ctx - the stream context to initialise.
+ * @param [in] led_ctx - the LED context the streams play on.
+ */
+void led_stream_ctx_init(led_stream_ctx_t * ctx, led_ctx_t * led_ctx);
+
+/** @brief Context version of led_stream_open(). */
+int32_t led_stream_ctx_open(led_stream_ctx_t * ctx, int32_t led_id, uint8_t half, uint32_t step_ms, led_stream_fill_fn_t fill);
+
+/** @brief Context version of led_stream_service(). */
+void led_stream_ctx_service(led_stream_ctx_t * ctx);
+
+/** @brief Context version of led_stream_get_state(). */
+led_stream_state_t led_stream_ctx_get_state(led_stream_ctx_t * ctx, int32_t stream_id);
+
+/** @brief Context version of led_stream_close(). */
+led_status_t led_stream_ctx_close(led_stream_ctx_t * ctx, int32_t stream_id);
+
+#endif
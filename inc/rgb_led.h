@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include "led.h"
+#include "scene.h"
 
 /**
  * @brief Holds state information for an rgb led's configuration.
@@ -42,6 +43,19 @@ typedef enum
     RGB_OFF,
 } rgb_state_t;
 
+/**
+ * @brief Holds the RGB leds and sequences of one LED context. The fields are private to the module,
+ * use the rgb_ctx_* functions.
+ */
+typedef struct
+{
+    rgb_led_t leds[LEDS_MAX];                /**The registered RGB leds. */
+    rgb_sequence_t sequences[MAX_SEQUENCES]; /**The registered RGB sequences. */
+    uint32_t led_count;                      /**Number of registered RGB leds. */
+    uint32_t seq_count;                      /**Number of registered RGB sequences. */
+    led_ctx_t * led;                         /**The LED context the channels are registered in. */
+} rgb_ctx_t;
+
 /**
  * @brief The inialisation for the rgb led wrapper. Initialization the state of all of the LEDs in the LED array and creates
  * some special sequences like white, red, blue and green ect...
@@ -136,4 +150,65 @@ bool rgb_sequence_exists(int32_t rgb_sequence_id);
  */
 bool rgb_led_exists(int32_t rgbLedId);
 
+/**
+ * @brief Fills in the three scene entries that put an RGB led on an RGB sequence, for building scene 
+ * tables with scene_register().
+ * @param [in] rgb_led_id - the id of the RGB led
+ * @param [in] rgb_sequence_id - the id of the rgb sequence the led runs in the scene
+ * @param [in] sequence_idx - position in the sequence the led starts from
+ * @param [in] enabled - true if the led is enabled in the scene
+ * @param [out] entries - array of at least 3 entries to be filled in, red, green then blue
+ *
+ * @return led_status_t - err if the led or sequence doesn't exist.
+ */
+led_status_t rgb_scene_entries(int32_t rgb_led_id, int32_t rgb_sequence_id, uint8_t sequence_idx, bool enabled, scene_entry_t *entries);
+
+/**
+ * @brief Returns the context used by the rgb functions without a context, built on the default LED context.
+ *
+ * @return rgb_ctx_t * - the default RGB context.
+ */
+rgb_ctx_t * rgb_get_default_ctx();
+
+/**
+ * @brief Context version of rgb_led_init(). Registers the colour sequences in the LED context's sequence
+ * table, so call after led_ctx_init().
+ * @param [in] ctx - the RGB context to initialise
+ * @param [in] led_ctx - the LED context the RGB leds and sequences are registered in
+ */
+void rgb_ctx_init(rgb_ctx_t *ctx, led_ctx_t *led_ctx);
+
+/** @brief Context version of rgb_led_get_count(). */
+uint32_t rgb_ctx_led_get_count(rgb_ctx_t *ctx);
+
+/** @brief Context version of rgb_sequence_get_count(). */
+uint32_t rgb_ctx_sequence_get_count(rgb_ctx_t *ctx);
+
+/** @brief Context version of rgb_led_on(). */
+led_status_t rgb_ctx_led_on(rgb_ctx_t *ctx, int32_t id, rgb_state_t colourCode);
+
+/** @brief Context version of rgb_led_register(). */
+int32_t rgb_ctx_led_register(rgb_ctx_t *ctx, pins_t red_pin, pins_t green_pin, pins_t blue_pin, led_t led_obj);
+
+/** @brief Context version of rgb_sequence_register(). */
+int32_t rgb_ctx_sequence_register(rgb_ctx_t *ctx, uint8_t length, uint16_t period, uint32_t *rgbSequence);
+
+/** @brief Context version of rgb_sequence_get_ids_from_id(). */
+void rgb_ctx_sequence_get_ids_from_id(rgb_ctx_t *ctx, int32_t rgbSequenceId, int32_t *redSequenceId, int32_t *greenSequenceId, int32_t *blueSequenceId);
+
+/** @brief Context version of rgb_assign_sequence(). */
+led_status_t rgb_ctx_assign_sequence(rgb_ctx_t *ctx, int32_t rgb_led_id, int32_t rgb_sequence_id);
+
+/** @brief Context version of rgb_led_get_ids_from_id(). */
+void rgb_ctx_led_get_ids_from_id(rgb_ctx_t *ctx, int32_t rgbLedId, int32_t *redLedId, int32_t *greenLedId, int32_t *blueLedId);
+
+/** @brief Context version of rgb_sequence_exists(). */
+bool rgb_ctx_sequence_exists(rgb_ctx_t *ctx, int32_t rgb_sequence_id);
+
+/** @brief Context version of rgb_led_exists(). */
+bool rgb_ctx_led_exists(rgb_ctx_t *ctx, int32_t rgbLedId);
+
+/** @brief Context version of rgb_scene_entries(). */
+led_status_t rgb_ctx_scene_entries(rgb_ctx_t *ctx, int32_t rgb_led_id, int32_t rgb_sequence_id, uint8_t sequence_idx, bool enabled, scene_entry_t *entries);
+
 #endif
@@ -0,0 +1,146 @@
+/**
+ * @file scene.h
+ * @brief Module for switching many LEDs between preregistered states at once. A scene is a table
+ * of LED assignments that is applied in full at the start of a single led_update_state(), so 
+ * an update never renders half of a mode change.
+ *
+ * Activating a scene only publishes a pointer, but the update that applies it then assigns every entry
+ * in turn, so that update takes time proportional to the length of the scene on top of its usual work.
+ * It isn't bounded by led_update_state_budget(). Keep scenes short where the update has to be.
+ */
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "led.h"
+
+/**
+ * @brief One LED's state in a scene.
+ */
+typedef struct
+{
+    int32_t led_id;       /**LED to be assigned. */
+    int32_t sequence_id;  /**Sequence the LED runs in the scene. */
+    uint8_t sequence_idx; /**Position in the sequence the LED starts from. */
+    bool enabled;         /**True if the LED is enabled in the scene. */
+} scene_entry_t;
+
+/**
+ * @brief A registered scene, pointing at the user's table.
+ */
+typedef struct
+{
+    const scene_entry_t * entries;
+    uint32_t length;
+} scene_t;
+
+/**
+ * @brief The scenes of one LED context. Attached to the LED context by scene_ctx_init() so its
+ * updates apply the scenes. The fields are private to the module, use the scene_ctx_* functions.
+ */
+typedef struct scene_ctx
+{
+    scene_t scenes[MAX_SCENES]; /**The registered scenes. */
+    uint32_t count;             /**Number of registered scenes. */
+    scene_t * pending;          /**Scene waiting to be applied by the next update, only accessed atomically. */
+    int32_t active;             /**ID of the scene last applied. */
+    uint32_t stale_count;       /**Entries skipped since init because their LED or sequence had been unregistered. */
+    led_ctx_t * led;            /**The LEDs the scenes are applied to. */
+} scene_ctx_t;
+
+/**
+ * @brief Initialises the scene module, forgetting all registered scenes. Called by led_init().
+ */
+void scene_init();
+
+/**
+ * @brief Registers a table of LED assignments as a scene. The table isn't copied, so it must stay 
+ * valid (e.g. be a static const table) for as long as the scene can be activated.
+ *
+ * @param [in] entries - the table of LED assignments.
+ * @param [in] length - the number of entries in the table.
+ *
+ * @return int32_t - If successfully registered returns the ID of the scene. If an entry references
+ * an LED or sequence that doesn't exist or there is no space left returns -1.
+ */
+int32_t scene_register(const scene_entry_t * entries, uint32_t length);
+
+/**
+ * @brief Returns the number of registered scenes.
+ *
+ * @return uint32_t - Number of registered scenes.
+ */
+uint32_t scene_get_count();
+
+/**
+ * @brief Requests that a scene is applied at the start of the next led_update_state(). Only publishes a 
+ * pointer, so it is constant time and safe to call from any task or interrupt. If called again before 
+ * the next update only the latest scene is applied. The update applying it takes time proportional to
+ * the number of entries in the scene.
+ *
+ * @param [in] scene_id - ID of the scene to be applied.
+ *
+ * @return led_status_t - err if the scene doesn't exist.
+ */
+led_status_t scene_activate(int32_t scene_id);
+
+/**
+ * @brief Returns the ID of the last scene applied by led_update_state().
+ *
+ * @return int32_t - ID of the scene, -1 if no scene has been applied since init.
+ */
+int32_t scene_get_active();
+
+/**
+ * @brief Returns the number of scene entries the updates have skipped since init. The entries are checked
+ * when the scene is registered, but an LED or sequence can be unregistered after that. An entry that
+ * refers to one is left out when the scene is applied, and the rest of the scene is still applied.
+ *
+ * @return uint32_t - Number of entries skipped.
+ */
+uint32_t scene_get_stale_count();
+
+/**
+ * @brief Applies the scene requested with scene_activate(), if any. Called by led_update_state() 
+ * before any LED is updated.
+ */
+void scene_service();
+
+/**
+ * @brief Returns the scenes used by the scene_* functions without a context, attached to the default
+ * LED context.
+ *
+ * @return scene_ctx_t * - the default scene context.
+ */
+scene_ctx_t * scene_get_default_ctx();
+
+/**
+ * @brief Context version of scene_init(). Forgets all registered scenes and attaches the scenes to an
+ * LED context, so that its updates apply them. Call after led_ctx_init().
+ *
+ * @param [in] ctx - the scene context to initialise.
+ * @param [in] led_ctx - the LED context the scenes apply to.
+ */
+void scene_ctx_init(scene_ctx_t * ctx, led_ctx_t * led_ctx);
+
+/** @brief Context version of scene_register(). */
+int32_t scene_ctx_register(scene_ctx_t * ctx, const scene_entry_t * entries, uint32_t length);
+
+/** @brief Context version of scene_get_count(). */
+uint32_t scene_ctx_get_count(scene_ctx_t * ctx);
+
+/** @brief Context version of scene_activate(). */
+led_status_t scene_ctx_activate(scene_ctx_t * ctx, int32_t scene_id);
+
+/** @brief Context version of scene_get_active(). */
+int32_t scene_ctx_get_active(scene_ctx_t * ctx);
+
+/** @brief Context version of scene_get_stale_count(). */
+uint32_t scene_ctx_get_stale_count(scene_ctx_t * ctx);
+
+/** @brief Context version of scene_service(). */
+void scene_ctx_service(scene_ctx_t * ctx);
+
+#endif
@@ -11,10 +11,32 @@
 #ifndef SEQUENCE_H
 #define SEQUENCE_H
 
+#include "led_config.h"
+
 #include <stdint.h>
 #include <stdbool.h>
 
-#define MAX_SEQUENCES 64
+/**
+ * IDs handed out for sequences and LEDs are handles, the slot in the low bits and the slot's generation 
+ * above them. A slot's generation goes up each time it's unregistered, so an ID kept after its sequence 
+ * or LED was unregistered no longer matches the slot and is rejected instead of addressing whatever 
+ * reuses it. A slot that has never been reused has generation 0, so its ID is just the slot.
+ */
+#define HANDLE_SLOT_BITS 16
+#define HANDLE_SLOT_MASK ((1u << HANDLE_SLOT_BITS) - 1)
+#define HANDLE_GENERATION_MAX 0x7FFF
+
+/** @brief Builds the ID of a slot with its generation. */
+#define HANDLE_MAKE(slot, generation) ((int32_t)(((uint32_t)(generation) << HANDLE_SLOT_BITS) | (uint32_t)(slot)))
+
+/** @brief The slot of an ID. */
+#define HANDLE_SLOT(handle) ((uint32_t)(handle) & HANDLE_SLOT_MASK)
+
+/** @brief The generation of an ID. */
+#define HANDLE_GENERATION(handle) ((uint32_t)(handle) >> HANDLE_SLOT_BITS)
+
+/** @brief The generation a slot moves on to when it's freed, 0 is skipped as it's only for unused slots. */
+#define HANDLE_NEXT_GENERATION(generation) ((uint16_t)((generation) % HANDLE_GENERATION_MAX + 1))
 
 /**
  * @brief Struct that stores sequences 
@@ -24,7 +46,15 @@
  * @param
  */
 
-#define MAX_SEQUENCE 100
+/** Every version of the sequences is kept in one of these buffers, see SEQUENCE_SPARE_BUFFERS. */
+#define SEQUENCE_BUFFERS (MAX_SEQUENCES + SEQUENCE_SPARE_BUFFERS)
+
+/** Marks an empty entry of the staged and replaced buffer tables. */
+#define SEQUENCE_NO_BUFFER 0xFF
+
+#if SEQUENCE_BUFFERS >= SEQUENCE_NO_BUFFER
+#error "SEQUENCE_BUFFERS must fit in the buffer indexes of a sequence table"
+#endif
 
 typedef struct{
     uint8_t sequence[MAX_SEQUENCE];
@@ -32,6 +62,33 @@ typedef struct{
     uint32_t period;
 }sequence_t;
 
+/**
+ * @brief A table of registered sequences. Independent tables can be used by different LED contexts, 
+ * the sequence_* functions without a context use a default table. Each sequence is only stored once,
+ * registering the same content again returns the existing ID and counts another reference to it.
+ */
+typedef struct{
+    sequence_t buffers[SEQUENCE_BUFFERS];   /**Storage for every version of the sequences. */
+    sequence_t * current[MAX_SEQUENCES];    /**The published version of each sequence. */
+    uint16_t free_buffers[SEQUENCE_BUFFERS]; /**Buffers that can be reused. */
+    uint32_t free_buffer_count;             /**Number of buffers in free_buffers. */
+    uint32_t buffers_used;                  /**Number of buffers handed out so far, free or not. */
+    uint16_t retired_buffers[SEQUENCE_BUFFERS]; /**Old versions that an update may still be reading. */
+    uint32_t retired_count;                 /**Number of buffers in retired_buffers. */
+    uint32_t readers;                       /**Number of updates reading the table right now. */
+    uint8_t staged[MAX_SEQUENCES];          /**Buffer waiting for sequence_ctx_commit() for each sequence, only accessed atomically. */
+    uint8_t replaced[MAX_SEQUENCES];        /**Buffer each commit unpublished, retired by the next table change, only accessed atomically. */
+    uint32_t hashes[MAX_SEQUENCES];     /**Content hash of each sequence, from sequence_hash(). */
+    uint16_t refs[MAX_SEQUENCES];       /**Number of times each sequence has been registered, 0 for a free slot. */
+    bool unique[MAX_SEQUENCES];         /**True for sequences from sequence_register_unique(), never shared. */
+    bool pinned[MAX_SEQUENCES];         /**True for sequences from sequence_pin(), never freed. */
+    uint16_t generations[MAX_SEQUENCES]; /**Generation of each slot, see HANDLE_MAKE(). */
+    uint8_t free_next[MAX_SEQUENCES];   /**The free slot after each free slot. */
+    uint8_t free_head;                  /**First free slot, valid when free_count is not 0. */
+    uint32_t free_count;                /**Number of unregistered slots waiting to be reused. */
+    uint32_t count;                     /**Number of slots used so far, registered or free. */
+}sequence_ctx_t;
+
 /**
  * @brief Sequence status variables 
  * 
@@ -47,7 +104,14 @@ typedef enum{
 void sequence_init();
 
 /**
- * @brief Registers a sequence to the module's state; an array of sequences.
+ * @brief Registers a sequence to the module's state; an array of sequences. A sequence with the same 
+ * length, period and steps as one already registered isn't stored again, its ID is returned and its
+ * reference count goes up. Registered sequences are shared and may be being read by an update, 
+ * change them with sequence_update() rather than through sequence_get_from_id().
+ *
+ * Because the ID is shared, changing an interned sequence changes it for everyone who registered the
+ * same content, and sequence_update() and led_update_sequence() move every LED showing it over to the
+ * new content. Register with sequence_register_unique() to get a sequence that can be changed on its own.
  *
  * @param sequence - A sequence object to store in the module state.
  * @return int32_t - If successfully registered returns the ID of the sequence. If error
@@ -56,7 +120,80 @@ void sequence_init();
 int32_t sequence_register(sequence_t sequence);
 
 /**
- * @brief Returns the current number of registered sequences 
+ * @brief Replaces the content of a registered sequence while updates may be running. The new version is 
+ * built in a spare buffer and published in one atomic store, so an update sees the old version or the
+ * new one and never a mix. LEDs showing the sequence keep their position and timing but show the new
+ * states from their next update, even part way through a step. The ID and reference count don't change.
+ * Use led_update_sequence() to switch the LEDs over at their next step and rewrite the ones that have
+ * finished or are showing a single state.
+ *
+ * @param sequence_id - the sequence to replace.
+ * @param sequence - the new content.
+ * @return sequence_status_t - SEQUENCE_ERROR if the ID isn't a registered sequence, a version staged 
+ * with sequence_ctx_stage() is waiting, or there is no spare buffer, when updates are still reading every
+ * retired version. Try again after the next update.
+ */
+sequence_status_t sequence_update(int32_t sequence_id, sequence_t sequence);
+
+/**
+ * @brief Registers a sequence that is never shared: it always gets its own slot, even if the same content
+ * is already registered, and later registrations of the same content don't reuse it. For sequences whose 
+ * content will be changed with sequence_update() without affecting anyone else's.
+ *
+ * @param sequence - A sequence object to store in the module state.
+ * @return int32_t - If successfully registered returns the ID of the sequence. If error
+ * returns -1 (SEQUENCE_ERROR).
+ */
+int32_t sequence_register_unique(sequence_t sequence);
+
+/**
+ * @brief Drops one registration of a sequence. When every registration of it has been dropped its
+ * slot is freed for the next new sequence and its ID stops being valid, LEDs still showing it stop.
+ * A sequence registered UINT16_MAX times or more has lost count and is never freed.
+ *
+ * @param sequence_id - the sequence.
+ * @return sequence_status_t - SEQUENCE_ERROR if the ID isn't a registered sequence, or dropping the
+ * registration would free a pinned sequence.
+ */
+sequence_status_t sequence_unregister(int32_t sequence_id);
+
+/**
+ * @brief Pins a sequence so it can't be unregistered, for sequences the rest of the code relies on like 
+ * the off and on sequences led_init() registers. Registrations of the same content can still be dropped,
+ * down to the first.
+ *
+ * @param sequence_id - the sequence.
+ * @return sequence_status_t - SEQUENCE_ERROR if the ID isn't a registered sequence.
+ */
+sequence_status_t sequence_pin(int32_t sequence_id);
+
+/**
+ * @brief Looks for a registered sequence with the same content, without registering it.
+ *
+ * @param sequence - the sequence to look for.
+ * @return int32_t - the ID of the matching sequence, -1 (SEQUENCE_ERROR) if there isn't one.
+ */
+int32_t sequence_find(const sequence_t * sequence);
+
+/**
+ * @brief Returns how many times a sequence has been registered.
+ * 
+ * @param sequence_id - the sequence.
+ * @return uint32_t - the reference count, 0 if the sequence doesn't exist.
+ */
+uint32_t sequence_get_refs(uint32_t sequence_id);
+
+/**
+ * @brief Hashes the content of a sequence (FNV-1a over the length, period and steps). Steps past the 
+ * length aren't part of the content.
+ * 
+ * @param sequence - the sequence to hash.
+ * @return uint32_t - the hash.
+ */
+uint32_t sequence_hash(const sequence_t * sequence);
+
+/**
+ * @brief Returns the current number of registered sequences, not counting unregistered ones
  * 
  * @return uint32_t - Number of registered sequences.
  */
@@ -78,4 +215,164 @@ bool sequence_exists(uint32_t sequence_id);
  */
  sequence_t * sequence_get_from_id(uint32_t sequence_id);
 
-#endif
\ No newline at end of file
+/**
+ * @brief Returns the default sequence table used by the functions without a context.
+ * 
+ * @return sequence_ctx_t * - the default table.
+ */
+sequence_ctx_t * sequence_get_default_ctx();
+
+/**
+ * @brief Context version of sequence_init().
+ * 
+ * @param ctx - the sequence table.
+ */
+void sequence_ctx_init(sequence_ctx_t * ctx);
+
+/**
+ * @brief Context version of sequence_register().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence - A sequence object to store in the table.
+ * @return int32_t - the ID of the sequence, -1 (SEQUENCE_ERROR) if the table is full.
+ */
+int32_t sequence_ctx_register(sequence_ctx_t * ctx, sequence_t sequence);
+
+/**
+ * @brief Context version of sequence_update().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence to replace.
+ * @param sequence - the new content.
+ * @return sequence_status_t - SEQUENCE_ERROR if the ID isn't a registered sequence or there is no spare buffer.
+ */
+sequence_status_t sequence_ctx_update(sequence_ctx_t * ctx, int32_t sequence_id, sequence_t sequence);
+
+/**
+ * @brief Context version of sequence_register_unique().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence - A sequence object to store in the table.
+ * @return int32_t - the ID of the sequence, -1 (SEQUENCE_ERROR) if the table is full.
+ */
+int32_t sequence_ctx_register_unique(sequence_ctx_t * ctx, sequence_t sequence);
+
+/**
+ * @brief Builds a new version of a sequence in a spare buffer without publishing it. The version is 
+ * published by sequence_ctx_commit(), which the LED driver calls from its update so the LEDs can be
+ * switched over in the same step, see led_update_sequence().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence to replace.
+ * @param sequence - the new content.
+ * @return sequence_status_t - SEQUENCE_ERROR if the ID isn't a registered sequence, a version is already 
+ * staged or there is no spare buffer.
+ */
+sequence_status_t sequence_ctx_stage(sequence_ctx_t * ctx, int32_t sequence_id, sequence_t sequence);
+
+/**
+ * @brief Returns the version of a sequence waiting to be committed.
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence.
+ * @return const sequence_t * - the staged version, NULL if there isn't one or the ID isn't registered.
+ */
+const sequence_t * sequence_ctx_get_staged(const sequence_ctx_t * ctx, int32_t sequence_id);
+
+/**
+ * @brief Publishes the version staged by sequence_ctx_stage(). Safe to call from an update in the timer
+ * interrupt, the buffer it replaces is only retired by the next stage, update or registration.
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence.
+ * @return bool - true if a version was published.
+ */
+bool sequence_ctx_commit(sequence_ctx_t * ctx, int32_t sequence_id);
+
+/**
+ * @brief Drops the version staged by sequence_ctx_stage() without publishing it, if it hasn't been 
+ * committed yet.
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence.
+ */
+void sequence_ctx_discard(sequence_ctx_t * ctx, int32_t sequence_id);
+
+/**
+ * @brief Marks the start of a read of the table by an update. Old versions of sequences aren't reused 
+ * while any read is in progress. Reads may nest and run on several cores at once.
+ * 
+ * @param ctx - the sequence table.
+ */
+void sequence_ctx_read_begin(sequence_ctx_t * ctx);
+
+/**
+ * @brief Marks the end of a read started with sequence_ctx_read_begin().
+ * 
+ * @param ctx - the sequence table.
+ */
+void sequence_ctx_read_end(sequence_ctx_t * ctx);
+
+/**
+ * @brief Context version of sequence_unregister().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence.
+ * @return sequence_status_t - SEQUENCE_ERROR if the ID isn't a registered sequence or is pinned.
+ */
+sequence_status_t sequence_ctx_unregister(sequence_ctx_t * ctx, int32_t sequence_id);
+
+/**
+ * @brief Context version of sequence_pin().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence.
+ * @return sequence_status_t - SEQUENCE_ERROR if the ID isn't a registered sequence.
+ */
+sequence_status_t sequence_ctx_pin(sequence_ctx_t * ctx, int32_t sequence_id);
+
+/**
+ * @brief Context version of sequence_find().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence - the sequence to look for.
+ * @return int32_t - the ID of the matching sequence, -1 (SEQUENCE_ERROR) if there isn't one.
+ */
+int32_t sequence_ctx_find(const sequence_ctx_t * ctx, const sequence_t * sequence);
+
+/**
+ * @brief Context version of sequence_get_refs().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence.
+ * @return uint32_t - the reference count, 0 if the sequence doesn't exist.
+ */
+uint32_t sequence_ctx_get_refs(const sequence_ctx_t * ctx, uint32_t sequence_id);
+
+/**
+ * @brief Context version of sequence_get_count().
+ * 
+ * @param ctx - the sequence table.
+ * @return uint32_t - Number of registered sequences.
+ */
+uint32_t sequence_ctx_get_count(const sequence_ctx_t * ctx);
+
+/**
+ * @brief Context version of sequence_exists().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - the sequence to look for.
+ * @return bool - Returns true if sequence exists.
+ */
+bool sequence_ctx_exists(const sequence_ctx_t * ctx, uint32_t sequence_id);
+
+/**
+ * @brief Context version of sequence_get_from_id().
+ * 
+ * @param ctx - the sequence table.
+ * @param sequence_id - index of the sequence in the table.
+ * @return sequence_t * - Returns pointer to object found. Else return NULL.
+ */
+sequence_t * sequence_ctx_get_from_id(sequence_ctx_t * ctx, uint32_t sequence_id);
+
+#endif
@@ -1,253 +1,2498 @@
 #include "led.h"
+#include "scene.h"
+#ifdef LED_BATCH
+#include "led_batch.h"
+#endif
 #include <string.h>
 #include <stdio.h>
 
-led_t led = {-1};
-
-led_t leds[LEDS_MAX] = {{-1}};
-
-// This is the number of LEDs in the array.
-static uint32_t count = 0;
-// This is the period in ms that the LEDs' state will be refreshed.
-static uint32_t timer_period = 0;
+// The context used by the functions without a context.
+static led_ctx_t led_default_ctx = {0};
 
 /*******************************/
 /* PRIVATE FUNCTION PROTOTYPES */
 /*******************************/
 
 /**
- * @brief Sets the initial value of all of the LEDs 
+ * @brief Sets the initial value of all of the LEDs
  * in the LED array
  */
-void init_led_array();
+void init_led_array(led_ctx_t * ctx);
+
+/**
+ * @brief Puts one slot of the LED array back to its initial state.
+ */
+void init_led_slot(led_ctx_t * ctx, uint32_t slot);
+
+/**
+ * @brief Finds the slot of a registered LED's ID.
+ *
+ * @param led_id - the ID, see HANDLE_MAKE().
+ * @return int32_t - the slot, -1 if the ID is out of range, unregistered or from an older generation.
+ */
+int32_t led_slot(led_ctx_t * ctx, int32_t led_id);
+
+/**
+ * @brief Returns the index of the lowest set bit in a mask word.
+ *
+ * @param mask - the mask word, must not be zero.
+ * @return uint32_t - bit index from 0 to 63.
+ */
+static inline uint32_t mask_lowest_bit(uint64_t mask);
+
+/**
+ * @brief Returns the bits of a mask word that correspond to registered LEDs.
+ *
+ * @param word - index of the mask word.
+ * @return uint64_t - mask of the registered LEDs in that word.
+ */
+uint64_t registered_mask(led_ctx_t * ctx, uint32_t word);
+
+/**
+ * @brief Marks an LED as having work to do in led_update_state(). If it wasn't active already
+ * its sequence timing starts from the current time.
+ *
+ * @param led_id - unique identifier of the target led.
+ */
+void active_add(led_ctx_t * ctx, uint32_t led_id);
+
+/**
+ * @brief Checks if an enabled LED still needs to be visited by led_update_state(). Static LEDs
+ * (sequence length of 1) only need visiting until their state has been written.
+ *
+ * @param led_id - unique identifier of the target led.
+ * @return bool - True if the LED should stay active.
+ */
+bool led_needs_update(led_ctx_t * ctx, uint32_t led_id);
+
+/**
+ * @brief Empties the command ring and clears any queued commands.
+ */
+void cmd_ring_init(led_ctx_t * ctx);
+
+/**
+ * @brief Claims a slot in the command ring and fills it. Safe to call from any number of
+ * tasks or interrupts at once, never blocks.
+ *
+ * @param type - the command to be queued.
+ * @param led_id - the LED the command applies to.
+ * @param arg - command argument, e.g. the sequence ID or offset.
+ * @return led_status_t - Err if the ring is full.
+ */
+led_status_t cmd_ring_push(led_ctx_t * ctx, led_cmd_type_t type, int32_t led_id, int32_t arg);
+
+/**
+ * @brief Applies every command in the ring in the order they were queued. Only called
+ * from led_update_state().
+ */
+void cmd_ring_drain(led_ctx_t * ctx);
+
+/**
+ * @brief Publishes the version of a sequence staged by led_update_sequence(). The LEDs showing it
+ * are switched over first: stepping LEDs keep their old state until their next step, the others 
+ * are written again. Only called from an update, so no LED is serviced in between.
+ *
+ * @param sequence_id - the sequence.
+ */
+void led_apply_sequence_update(led_ctx_t * ctx, int32_t sequence_id);
+
+/**
+ * @brief Marks the start of a change to the LED state. Readers that overlap the change retry.
+ */
+void state_write_begin(led_ctx_t * ctx);
+
+/**
+ * @brief Marks the end of a change to the LED state started by state_write_begin().
+ */
+void state_write_end(led_ctx_t * ctx);
+
+/**
+ * @brief Advances the sequence of an LED by the time since it was last serviced, writes its state
+ * and removes it from the active mask if it has nothing left to do.
+ *
+ * @param led_id - unique identifier of the target led, must be enabled and active.
+ * @param out - if not NULL the state is stored here instead of being written.
+ * @return bool - true if a state was written or stored.
+ */
+bool led_service(led_ctx_t * ctx, uint32_t led_id, led_output_t * out);
+
+/**
+ * @brief Moves an LED whose sequence has played its last time on to its next sequence, or holds it on
+ * the last state if there is none.
+ *
+ * @param led_id - unique identifier of the target led.
+ * @return sequence_t * - the sequence the LED now shows.
+ */
+sequence_t * led_sequence_ended(led_ctx_t * ctx, uint32_t led_id);
+
+/**
+ * @brief Starts an LED on a sequence from its first state, written on the next update.
+ *
+ * @param led_id - unique identifier of the target led.
+ * @param sequence_id - the sequence to show, must exist.
+ */
+void led_show_sequence(led_ctx_t * ctx, uint32_t led_id, int32_t sequence_id);
+
+/**
+ * @brief Assigns a sequence to an LED, or underneath its overlays if it has any.
+ *
+ * @param led_id - unique identifier of the target led.
+ * @param sequence_id - the sequence to assign, must exist.
+ */
+void led_assign(led_ctx_t * ctx, uint32_t led_id, int32_t sequence_id);
+
+#ifdef LED_OVERLAYS
+/**
+ * @brief Removes an overlay from an LED. If it was being shown, the overlay below it is shown, or the 
+ * assigned sequence is put back at the position it has reached in the meantime.
+ *
+ * @param led_id - unique identifier of the target led.
+ * @param position - position of the overlay in the LED's stack.
+ */
+void overlay_remove(led_ctx_t * ctx, uint32_t led_id, uint32_t position);
+
+/**
+ * @brief Removes every timed overlay that has expired and works out when the next one expires. Called 
+ * at the start of an update.
+ */
+void overlay_expire(led_ctx_t * ctx);
+#endif
+
+/**
+ * @brief Records that an event happened to an LED for the next dispatch, if events are being recorded.
+ *
+ * @param event - what happened.
+ * @param led_id - unique identifier of the target led.
+ */
+void led_raise_event(led_ctx_t * ctx, led_event_t event, uint32_t led_id);
+
+/**
+ * @brief Converts time passed into time in the LED's sequence at its playback rate, carrying the 
+ * fraction of a ms left over to the next call.
+ *
+ * @param led_id - unique identifier of the target led.
+ * @param elapsed - time passed in ms.
+ * @return uint32_t - sequence time in ms.
+ */
+uint32_t led_sequence_ms(led_ctx_t * ctx, uint32_t led_id, uint32_t elapsed);
+
+/**
+ * @brief Checks if an LED's rate divisor lets it be serviced in the current update.
+ *
+ * @param led_id - unique identifier of the target led.
+ * @return bool - true if the LED should be serviced.
+ */
+static inline bool led_is_due(led_ctx_t * ctx, uint32_t led_id);
+
+/**
+ * @brief Returns the time the LED next needs servicing: when its next step is due, or now if it
+ * has a write pending.
+ *
+ * @param led_id - unique identifier of the target led, must be active.
+ * @return uint32_t - the time in ms since init.
+ */
+uint32_t led_next_step_ms(led_ctx_t * ctx, uint32_t led_id);
+
+/**
+ * @brief Applies scenes and queued commands and advances the clock. Called at the start of every update.
+ *
+ * @param elapsed - time in ms since the last update.
+ */
+void update_begin(led_ctx_t * ctx, uint32_t elapsed);
+
+/**
+ * @brief Completes an update started with update_begin(), recording how long it took.
+ */
+void update_end(led_ctx_t * ctx);
+
+#ifdef LED_TRACE
+/**
+ * @brief Records a transition in the trace if the state differs from the last one written to the LED. 
+ * Workers of a parallel update each claim their own slot.
+ *
+ * @param i - id of the LED being written.
+ * @param state - state being written.
+ */
+void trace_record(led_ctx_t * ctx, uint32_t i, uint8_t state);
+#endif
+
+#ifdef LED_INSTRUMENTATION
+/**
+ * @brief Adds the duration of an update to the stats.
+ *
+ * @param cycles - duration of the update.
+ */
+void stats_record(led_ctx_t * ctx, uint32_t cycles);
+#endif
+
+#ifdef LED_BATCH
+/**
+ * @brief Updates the due LEDs of one mask word. LEDs that were serviced on the last update and are
+ * stepping through a sequence are advanced together by the batch kernel, the rest by led_service().
+ *
+ * @param word - index of the mask word.
+ * @param out - if not NULL the states are stored here instead of being written.
+ * @return uint32_t - number of states written or stored.
+ */
+uint32_t batch_update_word(led_ctx_t * ctx, uint32_t word, led_output_t * out);
+#endif
+
+/**
+ * @brief Services enabled, active LEDs of one priority class, resuming from a cursor and wrapping
+ * around at most once.
+ *
+ * @param priority - true to service the priority LEDs, false for the rest.
+ * @param cursor - ID the search starts from, left one past the last LED serviced.
+ * @param budget - maximum number of LEDs to service.
+ * @return uint32_t - number of LEDs serviced.
+ */
+uint32_t service_class(led_ctx_t * ctx, bool priority, uint32_t * cursor, uint32_t budget);
 
 /********************************/
 /* PRIVATE FUNCTION DEFINITIONS */
 /********************************/
 
-void init_led_array()
+void init_led_array(led_ctx_t * ctx)
 {
+    memset(ctx->enabled_mask, 0, sizeof(ctx->enabled_mask));
+    memset(ctx->active_mask, 0, sizeof(ctx->active_mask));
+    memset(ctx->priority_mask, 0, sizeof(ctx->priority_mask));
+    memset(ctx->free_mask, 0, sizeof(ctx->free_mask));
+    memset(ctx->swap_mask, 0, sizeof(ctx->swap_mask));
+
     // Initialize the array of leds
-    for(int i = 0; i < LEDS_MAX; i++)
+    for (int i = 0; i < LEDS_MAX; i++)
     {
-        memset(&(leds[i]), -1, sizeof(led_t));
+        init_led_slot(ctx, i);
+        ctx->generations[i] = 0;
     }
-}
-
-
-/*******************************/
-/* PUBLIC FUNCTION DEFINITIONS */
-/*******************************/
 
+#ifdef LED_OVERLAYS
+    memset(ctx->overlay_timed_mask, 0, sizeof(ctx->overlay_timed_mask));
+    ctx->overlay_timed_count = 0;
+#endif
+    ctx->free_count = 0;
+}
 
-void led_init(uint32_t _timer_period)
+void init_led_slot(led_ctx_t * ctx, uint32_t i)
 {
-    sequence_init();
-
-    init_led_array();
+    memset(&(ctx->leds[i]), -1, sizeof(led_t));
 
-    count = 0;
-    timer_period = _timer_period;
+    ctx->rate_divisor[i] = 1;
+    ctx->rate_phase[i] = 0;
+    ctx->tolerance_ms[i] = 0;
+    ctx->playback_rate[i] = LED_RATE_1X;
+    ctx->playback_fraction[i] = 0;
+    ctx->repeats_left[i] = 0;
+    ctx->next_sequence[i] = -1;
+    ctx->sequence_held[i] = false;
+#ifdef LED_OVERLAYS
+    ctx->overlay_depth[i] = 0;
+#endif
+}
 
-    // Create the "off sequence"
-    sequence_t sequence_off =
-    {
-        .length = 1,
-        .period = 1,
-        .sequence = {LED_OFF}
-    };
+int32_t led_slot(led_ctx_t * ctx, int32_t led_id)
+{
+    uint32_t slot = HANDLE_SLOT(led_id);
 
-    sequence_register(sequence_off);
-    
-    // Create the "on sequence"
-    sequence_t sequence_on =
+    if (led_id < 0 || slot >= ctx->count || ctx->generations[slot] != HANDLE_GENERATION(led_id) ||
+        (ctx->free_mask[slot / 64] >> (slot % 64)) & 1)
     {
-        .length = 1,
-        .period = 1,
-        .sequence = {LED_ON}
-    };
-
-    sequence_register(sequence_on);
+        return -1;
+    }
 
-    return;
+    return slot;
 }
 
-uint32_t led_get_count()
+static inline uint32_t mask_lowest_bit(uint64_t mask)
 {
-    return count;
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_ctzll(mask);
+#else
+    uint32_t bit = 0;
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
 }
 
-void led_on(int32_t id)
+uint64_t registered_mask(led_ctx_t * ctx, uint32_t word)
 {
-    if (count <= 0)
+    uint32_t first = word * 64;
+
+    if (ctx->count <= first)
     {
-        return;
+        return 0;
     }
 
-    if(leds[id].enabled)
+    if (ctx->count - first >= 64)
     {
-        write(leds[id].pinout, LED_ON);
+        return ~ctx->free_mask[word];
     }
+
+    return (((uint64_t)1 << (ctx->count - first)) - 1) & ~ctx->free_mask[word];
 }
 
-void led_off(int32_t id)
+void active_add(led_ctx_t * ctx, uint32_t led_id)
 {
-    if (count <= 0)
+    uint64_t bit = (uint64_t)1 << (led_id % 64);
+
+    if (!(ctx->active_mask[led_id / 64] & bit))
     {
-        return;
+        ctx->active_mask[led_id / 64] |= bit;
+        ctx->serviced_ms[led_id] = ctx->now_ms;
     }
-    
-    write(leds[id].pinout, LED_OFF);
 }
 
-int32_t led_register(led_t led_obj)
+bool led_needs_update(led_ctx_t * ctx, uint32_t led_id)
 {
-    if (count >= LEDS_MAX)
+    sequence_t * sequence = sequence_ctx_get_from_id(ctx->sequences, ctx->leds[led_id].sequence_id);
+
+    if (sequence == NULL)
     {
-        return -1;
+        return false;
     }
-    
-    leds[count] = led_obj;
 
-    return count++;
-}
-
-void led_disable(int32_t id)
-{
-    if(led_exists(id))
+    if (sequence->length > 1 && !ctx->sequence_held[led_id])
     {
-        leds[id].enabled = false; 
+        return true;
     }
+
+    // A static LED only has a pending write if it hasn't been written yet
+    return !ctx->leds[led_id].sequence_initialized;
 }
 
-void led_enable(int32_t id)
+void cmd_ring_init(led_ctx_t * ctx)
 {
-     if(led_exists(id))
+    for (uint32_t i = 0; i < LED_COMMAND_QUEUE_SIZE; i++)
     {
-        leds[id].enabled = true; 
+        __atomic_store_n(&ctx->cmd_ring[i].seq, i, __ATOMIC_RELAXED);
     }
-    
+
+    __atomic_store_n(&ctx->cmd_tail, 0, __ATOMIC_RELAXED);
+    ctx->cmd_head = 0;
 }
 
-led_status_t led_assign_sequence(int32_t led_id, int32_t sequence_id)
+led_status_t cmd_ring_push(led_ctx_t * ctx, led_cmd_type_t type, int32_t led_id, int32_t arg)
 {
-    // Check if LED exists
-    if(!led_exists(led_id))
-    {
-        return LED_ERR;
-    }
+    uint32_t pos = __atomic_load_n(&ctx->cmd_tail, __ATOMIC_RELAXED);
+    led_cmd_slot_t * slot;
 
-    // Check if sequence exists
-    if(!sequence_exists(sequence_id))
+    for (;;)
     {
-        return LED_ERR;
-    }
+        slot = &ctx->cmd_ring[pos % LED_COMMAND_QUEUE_SIZE];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - pos);
 
-    // Assign sequence to LED
+        if (diff == 0)
+        {
+            // The slot is free for this lap, try to claim it. On failure pos is reloaded.
+            if (__atomic_compare_exchange_n(&ctx->cmd_tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // The consumer hasn't freed this slot since the last lap, the ring is full
+            return LED_ERR;
+        }
+        else
+        {
+            // Another producer claimed the slot first
+            pos = __atomic_load_n(&ctx->cmd_tail, __ATOMIC_RELAXED);
+        }
+    }
 
-    leds[led_id].sequence_id = sequence_id;
-    leds[led_id].sequence_idx = 0;
-    leds[led_id].timer_count = 0;
-    leds[led_id].sequence_initialized = false;
+    slot->type = type;
+    slot->led_id = led_id;
+    slot->arg = arg;
 
-    
+    // Publish the command to the consumer
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
 
     return LED_OK;
 }
 
-int32_t led_get_sequence_id(int32_t led_id)
+void cmd_ring_drain(led_ctx_t * ctx)
 {
-    if (led_id >= LEDS_MAX)
+    for (;;)
     {
-        return -1;
+        led_cmd_slot_t * slot = &ctx->cmd_ring[ctx->cmd_head % LED_COMMAND_QUEUE_SIZE];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        // Empty, or the producer that claimed this slot hasn't finished filling it
+        if (seq != ctx->cmd_head + 1)
+        {
+            return;
+        }
+
+        switch (slot->type)
+        {
+            case LED_CMD_ASSIGN_SEQUENCE:
+                led_ctx_assign_sequence(ctx, slot->led_id, slot->arg);
+                break;
+            case LED_CMD_ENABLE:
+                led_ctx_enable(ctx, slot->led_id);
+                break;
+            case LED_CMD_DISABLE:
+                led_ctx_disable(ctx, slot->led_id);
+                break;
+            case LED_CMD_OFFSET_SEQUENCE:
+                led_ctx_offset_sequence(ctx, slot->led_id, (uint8_t)slot->arg);
+                break;
+            case LED_CMD_UPDATE_SEQUENCE:
+                led_apply_sequence_update(ctx, slot->arg);
+                break;
+            default:
+                break;
+        }
+
+        // Hand the slot back to the producers for the next lap
+        __atomic_store_n(&slot->seq, ctx->cmd_head + LED_COMMAND_QUEUE_SIZE, __ATOMIC_RELEASE);
+        ctx->cmd_head++;
     }
+}
 
-    return leds[led_id].sequence_id;
+void state_write_begin(led_ctx_t * ctx)
+{
+    if (ctx->state_write_depth++ == 0)
+    {
+        __atomic_fetch_add(&ctx->state_seq, 1, __ATOMIC_RELAXED);
+        // Keep the state writes after the counter goes odd
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
 }
 
-bool led_exists(int32_t led_id)
+void state_write_end(led_ctx_t * ctx)
 {
-    return led_id < count;
+    if (--ctx->state_write_depth == 0)
+    {
+        __atomic_fetch_add(&ctx->state_seq, 1, __ATOMIC_RELEASE);
+    }
 }
 
-void led_update_state()
+bool led_service(led_ctx_t * ctx, uint32_t i, led_output_t * out)
 {
-    // uint32_t sequence_id = led_get_sequence_id(led.id);
-    for (int i = 0; i < count; i++)
+    led_t * led = &ctx->leds[i];
+    uint32_t elapsed = ctx->now_ms - ctx->serviced_ms[i];
+    ctx->serviced_ms[i] = ctx->now_ms;
+
+    sequence_t * sequence = sequence_ctx_get_from_id(ctx->sequences, led->sequence_id);
+
+    if (sequence == NULL)
+    {
+        ctx->active_mask[i / 64] &= ~((uint64_t)1 << (i % 64));
+        return false;
+    }
+
+    uint32_t thresh = sequence->period/sequence->length;
+    bool stepped = false;
+
+    led->timer_count += led_sequence_ms(ctx, i, elapsed);
+
+    // The sequence doesn't move until its first state has been written
+    if (led->sequence_initialized)
     {
-        uint32_t sequence_id = leds[i].sequence_id;
+        // A sequence advances at most one step per timer period, so a step shorter than the
+        // timer period moves once per update and the time it overran by carries on. A playback rate
+        // of 0 freezes it.
+        uint32_t steps = ctx->timer_period ? (elapsed + ctx->timer_period - 1) / ctx->timer_period : 1;
 
-        if (!sequence_exists(sequence_id))
+        if (ctx->playback_rate[i] == 0)
         {
-            continue;
+            steps = 0;
+        }
+
+        if (thresh > 0 && led->timer_count / thresh < steps)
+        {
+            steps = led->timer_count / thresh;
         }
 
-        sequence_t * sequence = sequence_get_from_id(sequence_id);
-        
-        float thresh = sequence->period/sequence->length;
-        
-        leds[i].timer_count += timer_period;
-        
-        if (leds[i].timer_count >= thresh && leds[i].sequence_initialized)
+        led->timer_count -= steps * thresh;
+
+        if (steps > 0 && !ctx->sequence_held[i])
         {
-            leds[i].sequence_idx += 1; 
+            stepped = true;
 
-            if(leds[i].sequence_idx > (sequence->length-1))
+            // An offset past the end of the sequence wraps back to the start on the next step
+            uint32_t idx = led->sequence_idx < sequence->length ? led->sequence_idx : sequence->length - 1;
+            uint64_t plays = ((uint64_t)idx + steps) / sequence->length;
+
+            if (plays > 0)
             {
-                leds[i].sequence_idx = 0;
+                led_raise_event(ctx, LED_EVENT_CYCLE, i);
             }
-                    
-            leds[i].timer_count = leds[i].timer_count - thresh;
-        }
-        
-        if(leds[i].enabled)
-        {
-            write(leds[i].pinout, sequence->sequence[leds[i].sequence_idx]);
 
-            if(!leds[i].sequence_initialized)
+            if (ctx->repeats_left[i] > 0 && plays >= ctx->repeats_left[i])
             {
-                leds[i].sequence_initialized = true;   
+                sequence = led_sequence_ended(ctx, i);
             }
-            continue;
+            else
+            {
+                if (ctx->repeats_left[i] > 0)
+                {
+                    ctx->repeats_left[i] -= plays;
+                }
+                led->sequence_idx = (idx + steps % sequence->length) % sequence->length;
+            }
+        }
+    }
+
+    uint8_t state = sequence->sequence[led->sequence_idx];
+    uint64_t swap_bit = (uint64_t)1 << (i % 64);
+
+    // An updated sequence shows from the LED's next step, until then it keeps its old state
+    if (ctx->swap_mask[i / 64] & swap_bit)
+    {
+        if (stepped)
+        {
+            ctx->swap_mask[i / 64] &= ~swap_bit;
+        }
+        else
+        {
+            state = ctx->swap_state[i];
         }
-        
     }
+
+#ifdef LED_TRACE
+    trace_record(ctx, i, state);
+#endif
+
+    if (out != NULL)
+    {
+        out->pinout = led->pinout;
+        out->state = state;
+    }
+    else
+    {
+        ctx->write(led->pinout, state);
+    }
+
+    if(!led->sequence_initialized)
+    {
+        led->sequence_initialized = true;
+    }
+
+    if (!led_needs_update(ctx, i))
+    {
+        ctx->active_mask[i / 64] &= ~((uint64_t)1 << (i % 64));
+    }
+
+    return true;
 }
 
-void led_turn_on(int32_t led_id)
+static inline bool led_is_due(led_ctx_t * ctx, uint32_t led_id)
 {
-    led_assign_sequence(led_id, 1); 
+    return ctx->rate_divisor[led_id] <= 1 || (ctx->update_count + ctx->rate_phase[led_id]) % ctx->rate_divisor[led_id] == 0;
 }
 
-void led_turn_off(int32_t led_id)
+sequence_t * led_sequence_ended(led_ctx_t * ctx, uint32_t i)
 {
-    led_assign_sequence(led_id, 0); 
+    led_t * led = &ctx->leds[i];
+    int32_t next_id = ctx->next_sequence[i];
+    sequence_t * next = sequence_ctx_get_from_id(ctx->sequences, next_id);
+
+    ctx->repeats_left[i] = 0;
+    ctx->next_sequence[i] = -1;
+    led->timer_count = 0;
+
+    led_raise_event(ctx, LED_EVENT_FINISHED, i);
+
+    if (next == NULL)
+    {
+        sequence_t * sequence = sequence_ctx_get_from_id(ctx->sequences, led->sequence_id);
+        led->sequence_idx = sequence->length - 1;
+        ctx->sequence_held[i] = true;
+        return sequence;
+    }
+
+    led->sequence_id = next_id;
+    led->sequence_idx = 0;
+    return next;
 }
 
-void led_print(int32_t id)
+void led_show_sequence(led_ctx_t * ctx, uint32_t i, int32_t sequence_id)
 {
-    printf( "id: %d\n"
-            "enabled: %d\n"
-            "pinout: ..\n"
-            "sequence_id: %d\n"
-            "sequence_idx: %d\n"
-            "timer_count: %d\n", (int)id, leds[id].enabled, (int)leds[id].sequence_id, leds[id].sequence_idx, (int)leds[id].timer_count);
+    ctx->leds[i].sequence_id = sequence_id;
+    ctx->leds[i].sequence_idx = 0;
+    ctx->leds[i].timer_count = 0;
+    ctx->leds[i].sequence_initialized = false;
+    ctx->serviced_ms[i] = ctx->now_ms;
+    ctx->repeats_left[i] = 0;
+    ctx->next_sequence[i] = -1;
+    ctx->sequence_held[i] = false;
+    ctx->swap_mask[i / 64] &= ~((uint64_t)1 << (i % 64));
+
+    active_add(ctx, i);
 }
 
-led_t * led_get_from_id(uint32_t led_id)
+void led_assign(led_ctx_t * ctx, uint32_t i, int32_t sequence_id)
 {
-    if (!led_exists(led_id))
+#ifdef LED_OVERLAYS
+    if (ctx->overlay_depth[i] > 0)
     {
-        return NULL;
+        // The overlays stay, the sequence starts underneath them from now
+        led_overlay_base_t * base = &ctx->overlay_base[i];
+
+        base->led.sequence_id = sequence_id;
+        base->led.sequence_idx = 0;
+        base->led.timer_count = 0;
+        base->led.sequence_initialized = false;
+        base->serviced_ms = ctx->now_ms;
+        base->repeats_left = 0;
+        base->next_sequence = -1;
+        base->held = false;
+        return;
     }
-    return &(leds[led_id]);
+#endif
+
+    led_show_sequence(ctx, i, sequence_id);
 }
 
-void led_offset_sequence(uint32_t led_id, uint8_t seq_offset)
+#ifdef LED_OVERLAYS
+void overlay_remove(led_ctx_t * ctx, uint32_t i, uint32_t position)
 {
-    if(!led_exists(led_id))
+    led_overlay_t * overlays = ctx->overlays[i];
+    bool was_shown = position == ctx->overlay_depth[i] - 1u;
+    bool timed = false;
+
+    if (overlays[position].timed)
+    {
+        ctx->overlay_timed_count--;
+    }
+
+    for (uint32_t n = position; n + 1 < ctx->overlay_depth[i]; n++)
+    {
+        overlays[n] = overlays[n + 1];
+    }
+    ctx->overlay_depth[i]--;
+
+    for (uint32_t n = 0; n < ctx->overlay_depth[i]; n++)
+    {
+        timed |= overlays[n].timed;
+    }
+    if (!timed)
+    {
+        ctx->overlay_timed_mask[i / 64] &= ~((uint64_t)1 << (i % 64));
+    }
+
+    if (!was_shown)
+    {
+        return;
+    }
+
+    if (ctx->overlay_depth[i] > 0)
     {
+        led_show_sequence(ctx, i, overlays[ctx->overlay_depth[i] - 1].sequence_id);
         return;
     }
-    leds[led_id].sequence_idx = seq_offset;
+
+    // Back to the assigned sequence. The update catches it up on the time it spent covered, the
+    // same as an LED whose rate divisor let it skip updates.
+    led_overlay_base_t * base = &ctx->overlay_base[i];
+    led_t * led = &ctx->leds[i];
+
+    led->sequence_id = base->led.sequence_id;
+    led->sequence_idx = base->led.sequence_idx;
+    led->timer_count = base->led.timer_count;
+    led->sequence_initialized = base->led.sequence_initialized;
+    ctx->serviced_ms[i] = base->serviced_ms;
+    ctx->repeats_left[i] = base->repeats_left;
+    ctx->next_sequence[i] = base->next_sequence;
+    ctx->sequence_held[i] = base->held;
+
+    // A static or finished sequence has nothing to catch up on, it just needs writing again
+    sequence_t * sequence = sequence_ctx_get_from_id(ctx->sequences, led->sequence_id);
+    if (sequence == NULL || sequence->length <= 1 || base->held)
+    {
+        led->sequence_initialized = false;
+    }
+
+    ctx->active_mask[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+void overlay_expire(led_ctx_t * ctx)
+{
+    uint32_t next_expiry = ctx->now_ms + UINT32_MAX / 2;
+
+    for (uint32_t word = 0; word < LED_MASK_WORDS; word++)
+    {
+        uint64_t timed = ctx->overlay_timed_mask[word];
+
+        while (timed)
+        {
+            uint32_t i = word * 64 + mask_lowest_bit(timed);
+            timed &= timed - 1;
+
+            // From the top down so positions below aren't moved before they are checked
+            for (int32_t n = ctx->overlay_depth[i] - 1; n >= 0; n--)
+            {
+                led_overlay_t * overlay = &ctx->overlays[i][n];
+
+                if (!overlay->timed)
+                {
+                    continue;
+                }
+
+                if ((int32_t)(ctx->now_ms - overlay->expires_ms) >= 0)
+                {
+                    overlay_remove(ctx, i, n);
+                }
+                else if ((int32_t)(overlay->expires_ms - next_expiry) < 0)
+                {
+                    next_expiry = overlay->expires_ms;
+                }
+            }
+        }
+    }
+
+    ctx->overlay_next_expiry = next_expiry;
+}
+#endif
+
+uint32_t led_sequence_ms(led_ctx_t * ctx, uint32_t i, uint32_t elapsed)
+{
+    if (ctx->playback_rate[i] == LED_RATE_1X)
+    {
+        return elapsed;
+    }
+
+    uint64_t scaled = (uint64_t)elapsed * ctx->playback_rate[i] + ctx->playback_fraction[i];
+    ctx->playback_fraction[i] = scaled & 0xFF;
+
+    return scaled >> 8;
+}
+
+void led_raise_event(led_ctx_t * ctx, led_event_t event, uint32_t i)
+{
+    if (ctx->event_callback == NULL)
+    {
+        return;
+    }
+
+    // Parallel workers share nothing but the dispatch can run at the same time
+    __atomic_fetch_or(&ctx->event_masks[event][i / 64], (uint64_t)1 << (i % 64), __ATOMIC_RELAXED);
+}
+
+uint32_t led_next_step_ms(led_ctx_t * ctx, uint32_t i)
+{
+    led_t * led = &ctx->leds[i];
+    sequence_t * sequence = sequence_ctx_get_from_id(ctx->sequences, led->sequence_id);
+
+    // Nothing to show or the first state hasn't been written, service straight away
+    if (sequence == NULL || !led->sequence_initialized)
+    {
+        return ctx->serviced_ms[i];
+    }
+
+    uint32_t thresh = sequence->period/sequence->length;
+
+    if (thresh == 0)
+    {
+        return ctx->serviced_ms[i] + ctx->timer_period;
+    }
+
+    // Overdue steps still only advance one per timer period, so can't be taken before time moves on
+    if (led->timer_count >= thresh)
+    {
+        return ctx->serviced_ms[i] + 1;
+    }
+
+    uint32_t rate = ctx->playback_rate[i];
+
+    if (rate == LED_RATE_1X)
+    {
+        return ctx->serviced_ms[i] + (thresh - led->timer_count);
+    }
+
+    if (rate == 0)
+    {
+        // Frozen, never steps
+        return ctx->serviced_ms[i] + INT32_MAX / 2;
+    }
+
+    // Time for the rest of the step to play at the LED's rate, rounded up to whole ms
+    uint64_t left = (uint64_t)(thresh - led->timer_count) * LED_RATE_1X - ctx->playback_fraction[i];
+    return ctx->serviced_ms[i] + (uint32_t)((left + rate - 1) / rate);
+}
+
+void update_begin(led_ctx_t * ctx, uint32_t elapsed)
+{
+#ifdef LED_INSTRUMENTATION
+    if (ctx->cycle_counter != NULL)
+    {
+        ctx->update_start = ctx->cycle_counter();
+    }
+#endif
+
+    // Sequence versions replaced during the update aren't reused until it's over
+    sequence_ctx_read_begin(ctx->sequences);
+
+    // Switch scene first so that commands queued since are applied on top of it
+    if (ctx->scenes != NULL)
+    {
+        scene_ctx_service(ctx->scenes);
+    }
+
+    // Apply anything queued by other tasks since the last update
+    cmd_ring_drain(ctx);
+
+    ctx->now_ms += elapsed;
+    ctx->update_count++;
+
+#ifdef LED_OVERLAYS
+    if (ctx->overlay_timed_count > 0 && (int32_t)(ctx->now_ms - ctx->overlay_next_expiry) >= 0)
+    {
+        overlay_expire(ctx);
+    }
+#endif
+}
+
+void update_end(led_ctx_t * ctx)
+{
+#ifdef LED_INSTRUMENTATION
+    if (ctx->cycle_counter != NULL)
+    {
+        stats_record(ctx, ctx->cycle_counter() - ctx->update_start);
+    }
+#endif
+
+    sequence_ctx_read_end(ctx->sequences);
+    state_write_end(ctx);
+}
+
+#ifdef LED_TRACE
+void trace_record(led_ctx_t * ctx, uint32_t i, uint8_t state)
+{
+    if (ctx->trace_state[i] == state)
+    {
+        return;
+    }
+
+    uint32_t slot = __atomic_fetch_add(&ctx->trace_count, 1, __ATOMIC_RELAXED) & (LED_TRACE_SIZE - 1);
+    led_trace_entry_t * entry = &ctx->trace[slot];
+
+    entry->time_ms = ctx->now_ms;
+    entry->led_id = i;
+    entry->old_state = ctx->trace_state[i];
+    entry->new_state = state;
+
+    ctx->trace_state[i] = state;
+}
+#endif
+
+#ifdef LED_INSTRUMENTATION
+void stats_record(led_ctx_t * ctx, uint32_t cycles)
+{
+    led_stats_t * stats = &ctx->stats;
+
+    if (stats->calls == 0 || cycles < stats->min_cycles)
+    {
+        stats->min_cycles = cycles;
+    }
+
+    if (cycles > stats->max_cycles)
+    {
+        stats->max_cycles = cycles;
+    }
+
+    stats->calls++;
+    stats->total_cycles += cycles;
+
+    if (ctx->cycle_budget > 0 && cycles > ctx->cycle_budget)
+    {
+        stats->overruns++;
+    }
+
+    // Bucket is the number of bits needed to hold the duration
+    stats->histogram[cycles ? 32 - __builtin_clz(cycles) : 0]++;
+}
+#endif
+
+#ifdef LED_BATCH
+uint32_t batch_update_word(led_ctx_t * ctx, uint32_t word, led_output_t * out)
+{
+    led_batch_t batch;
+    uint8_t lane[64];
+    uint64_t due = 0;
+    uint64_t batched = 0;
+    uint32_t outputs = 0;
+    const uint8_t * table = (const uint8_t *)ctx->sequences->buffers;
+
+    batch.count = 0;
+
+    uint64_t pending = ctx->active_mask[word] & ctx->enabled_mask[word];
+    while (pending)
+    {
+        uint32_t bit = mask_lowest_bit(pending);
+        uint32_t i = word * 64 + bit;
+        pending &= pending - 1;
+
+        if (!led_is_due(ctx, i))
+        {
+            continue;
+        }
+
+        due |= (uint64_t)1 << bit;
+
+        led_t * led = &ctx->leds[i];
+        sequence_t * sequence = sequence_ctx_get_from_id(ctx->sequences, led->sequence_id);
+
+        // Only LEDs moving at most one step with nothing else to handle fit the kernel, the states 
+        // after the sequence keep the kernel's 4 byte reads inside the sequence_t. Sequences that end
+        // after a number of plays are left to led_service().
+        if (sequence == NULL || !led->sequence_initialized || sequence->length <= 1 || 
+            ctx->repeats_left[i] > 0 || ctx->playback_rate[i] != LED_RATE_1X || ctx->sequence_held[i] ||
+            (ctx->swap_mask[word] & ((uint64_t)1 << bit)) ||
+            led->sequence_idx >= sequence->length || ctx->now_ms - ctx->serviced_ms[i] != ctx->timer_period)
+        {
+            continue;
+        }
+
+        uint32_t n = batch.count++;
+        batch.timer_count[n] = led->timer_count;
+        batch.step_ms[n] = sequence->period/sequence->length;
+        batch.idx[n] = led->sequence_idx;
+        batch.length[n] = sequence->length;
+        batch.seq_offset[n] = sequence->sequence - table;
+        batched |= (uint64_t)1 << bit;
+        lane[bit] = n;
+    }
+
+    led_batch_advance(&batch, ctx->timer_period, table);
+
+    // Write in LED order, the same as a serial update
+    while (due)
+    {
+        uint32_t bit = mask_lowest_bit(due);
+        uint32_t i = word * 64 + bit;
+        due &= due - 1;
+
+        if (!(batched & ((uint64_t)1 << bit)))
+        {
+            if (led_service(ctx, i, out ? &out[outputs] : NULL))
+            {
+                outputs++;
+            }
+            continue;
+        }
+
+        led_t * led = &ctx->leds[i];
+        uint32_t n = lane[bit];
+
+        // The kernel only moves one step, going backwards means it wrapped
+        if (batch.idx[n] < led->sequence_idx)
+        {
+            led_raise_event(ctx, LED_EVENT_CYCLE, i);
+        }
+
+        led->timer_count = batch.timer_count[n];
+        led->sequence_idx = batch.idx[n];
+        ctx->serviced_ms[i] = ctx->now_ms;
+
+#ifdef LED_TRACE
+        trace_record(ctx, i, batch.state[n]);
+#endif
+
+        if (out != NULL)
+        {
+            out[outputs].pinout = led->pinout;
+            out[outputs].state = batch.state[n];
+        }
+        else
+        {
+            ctx->write(led->pinout, batch.state[n]);
+        }
+        outputs++;
+    }
+
+    return outputs;
+}
+#endif
+
+uint32_t service_class(led_ctx_t * ctx, bool priority, uint32_t * cursor, uint32_t budget)
+{
+    uint32_t serviced = 0;
+    uint32_t start = *cursor % (LED_MASK_WORDS * 64);
+
+    // One extra word so the bits before the cursor in the starting word are visited last
+    for (uint32_t n = 0; n <= LED_MASK_WORDS && serviced < budget; n++)
+    {
+        uint32_t word = (start / 64 + n) % LED_MASK_WORDS;
+        uint64_t pending = ctx->active_mask[word] & ctx->enabled_mask[word];
+
+        pending &= priority ? ctx->priority_mask[word] : ~ctx->priority_mask[word];
+
+        if (n == 0)
+        {
+            pending &= UINT64_MAX << (start % 64);
+        }
+        else if (n == LED_MASK_WORDS)
+        {
+            pending &= ((uint64_t)1 << (start % 64)) - 1;
+        }
+
+        while (pending && serviced < budget)
+        {
+            uint32_t i = word * 64 + mask_lowest_bit(pending);
+            pending &= pending - 1;
+
+            if (!led_is_due(ctx, i))
+            {
+                continue;
+            }
+
+            led_service(ctx, i, NULL);
+
+            serviced++;
+            *cursor = i + 1;
+        }
+    }
+
+    return serviced;
+}
+
+/***************************************/
+/* PUBLIC CONTEXT FUNCTION DEFINITIONS */
+/***************************************/
+
+led_ctx_t * led_get_default_ctx()
+{
+    return &led_default_ctx;
+}
+
+void led_ctx_init(led_ctx_t * ctx, sequence_ctx_t * sequences, uint32_t _timer_period)
+{
+    ctx->sequences = sequences;
+    ctx->scenes = NULL;
+    ctx->write = write;
+
+    sequence_ctx_init(ctx->sequences);
+
+    init_led_array(ctx);
+    cmd_ring_init(ctx);
+
+    ctx->count = 0;
+    ctx->timer_period = _timer_period;
+    ctx->now_ms = 0;
+    ctx->update_count = 0;
+    ctx->priority_cursor = 0;
+    ctx->normal_cursor = 0;
+    ctx->state_write_depth = 0;
+#ifdef LED_BATCH
+    ctx->batch_update = false;
+#endif
+    ctx->event_callback = NULL;
+    memset(ctx->event_masks, 0, sizeof(ctx->event_masks));
+#ifdef LED_INSTRUMENTATION
+    ctx->cycle_counter = NULL;
+    ctx->cycle_budget = 0;
+    led_ctx_reset_stats(ctx);
+#endif
+#ifdef LED_TRACE
+    memset(ctx->trace_state, LED_UNDEFINED, sizeof(ctx->trace_state));
+    led_ctx_clear_trace(ctx);
+#endif
+
+    // Create the "off sequence"
+    sequence_t sequence_off =
+    {
+        .length = 1,
+        .period = 1,
+        .sequence = {LED_OFF}
+    };
+
+    sequence_ctx_pin(ctx->sequences, sequence_ctx_register(ctx->sequences, sequence_off));
+
+    // Create the "on sequence"
+    sequence_t sequence_on =
+    {
+        .length = 1,
+        .period = 1,
+        .sequence = {LED_ON}
+    };
+
+    sequence_ctx_pin(ctx->sequences, sequence_ctx_register(ctx->sequences, sequence_on));
+
+    return;
+}
+
+void led_ctx_set_write(led_ctx_t * ctx, led_write_fn_t write_fn)
+{
+    ctx->write = write_fn ? write_fn : write;
+}
+
+#ifdef LED_BATCH
+void led_ctx_set_batch_update(led_ctx_t * ctx, bool enabled)
+{
+    ctx->batch_update = enabled;
+}
+#endif
+
+uint32_t led_ctx_get_count(led_ctx_t * ctx)
+{
+    return ctx->count - ctx->free_count;
+}
+
+void led_ctx_on(led_ctx_t * ctx, int32_t id)
+{
+    int32_t slot = led_slot(ctx, id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+
+    if(led_ctx_is_enabled(ctx, id))
+    {
+        ctx->write(ctx->leds[slot].pinout, LED_ON);
+    }
+}
+
+void led_ctx_off(led_ctx_t * ctx, int32_t id)
+{
+    int32_t slot = led_slot(ctx, id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+
+    ctx->write(ctx->leds[slot].pinout, LED_OFF);
+}
+
+int32_t led_ctx_register(led_ctx_t * ctx, led_t led_obj)
+{
+    if (ctx->count >= LEDS_MAX && ctx->free_count == 0)
+    {
+        return -1;
+    }
+
+    state_write_begin(ctx);
+
+    uint32_t slot;
+
+    if (ctx->free_count > 0)
+    {
+        // Reuse the most recently freed slot
+        slot = ctx->free_head;
+        ctx->free_head = ctx->free_next[slot];
+        ctx->free_count--;
+        ctx->free_mask[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+    }
+    else
+    {
+        slot = ctx->count++;
+    }
+
+    ctx->leds[slot] = led_obj;
+
+    if (led_obj.enabled)
+    {
+        ctx->enabled_mask[slot / 64] |= (uint64_t)1 << (slot % 64);
+    }
+
+    if (sequence_ctx_exists(ctx->sequences, led_obj.sequence_id))
+    {
+        active_add(ctx, slot);
+    }
+
+    state_write_end(ctx);
+
+    return HANDLE_MAKE(slot, ctx->generations[slot]);
+}
+
+led_status_t led_ctx_unregister(led_ctx_t * ctx, int32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return LED_ERR;
+    }
+
+    state_write_begin(ctx);
+
+#ifdef LED_OVERLAYS
+    // Overlays are removed first so the count of timed overlays stays right
+    while (ctx->overlay_depth[slot] > 0)
+    {
+        overlay_remove(ctx, slot, ctx->overlay_depth[slot] - 1);
+    }
+#endif
+
+    uint64_t bit = (uint64_t)1 << (slot % 64);
+    uint32_t word = slot / 64;
+
+    ctx->enabled_mask[word] &= ~bit;
+    ctx->active_mask[word] &= ~bit;
+    ctx->priority_mask[word] &= ~bit;
+    ctx->swap_mask[word] &= ~bit;
+    for (int event = 0; event < LED_EVENT_COUNT; event++)
+    {
+        __atomic_fetch_and(&ctx->event_masks[event][word], ~bit, __ATOMIC_RELAXED);
+    }
+#ifdef LED_TRACE
+    ctx->trace_state[slot] = LED_UNDEFINED;
+#endif
+
+    init_led_slot(ctx, slot);
+    ctx->generations[slot] = HANDLE_NEXT_GENERATION(ctx->generations[slot]);
+    ctx->free_mask[word] |= bit;
+    ctx->free_next[slot] = ctx->free_head;
+    ctx->free_head = slot;
+    ctx->free_count++;
+
+    state_write_end(ctx);
+
+    return LED_OK;
+}
+
+void led_ctx_disable(led_ctx_t * ctx, int32_t id)
+{
+    int32_t slot = led_slot(ctx, id);
+
+    if(slot != -1)
+    {
+        led_ctx_disable_mask(ctx, slot / 64, (uint64_t)1 << (slot % 64));
+    }
+}
+
+void led_ctx_enable(led_ctx_t * ctx, int32_t id)
+{
+    int32_t slot = led_slot(ctx, id);
+
+    if(slot != -1)
+    {
+        led_ctx_enable_mask(ctx, slot / 64, (uint64_t)1 << (slot % 64));
+    }
+
+}
+
+bool led_ctx_is_enabled(led_ctx_t * ctx, int32_t id)
+{
+    int32_t slot = led_slot(ctx, id);
+
+    if (slot == -1)
+    {
+        return false;
+    }
+
+    return (ctx->enabled_mask[slot / 64] >> (slot % 64)) & 1;
+}
+
+void led_ctx_enable_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask)
+{
+    if (word >= LED_MASK_WORDS)
+    {
+        return;
+    }
+
+    mask &= registered_mask(ctx, word);
+
+    state_write_begin(ctx);
+
+    // LEDs that were paused or idle restart their sequence timing from now
+    uint64_t restarted = mask & ~(ctx->enabled_mask[word] & ctx->active_mask[word]);
+    while (restarted)
+    {
+        ctx->serviced_ms[word * 64 + mask_lowest_bit(restarted)] = ctx->now_ms;
+        restarted &= restarted - 1;
+    }
+
+    ctx->enabled_mask[word] |= mask;
+    // Newly enabled LEDs need their state written again on the next update
+    ctx->active_mask[word] |= mask;
+
+    state_write_end(ctx);
+}
+
+void led_ctx_disable_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask)
+{
+    if (word >= LED_MASK_WORDS)
+    {
+        return;
+    }
+
+    state_write_begin(ctx);
+    ctx->enabled_mask[word] &= ~mask;
+    state_write_end(ctx);
+}
+
+uint64_t led_ctx_get_enabled_mask(led_ctx_t * ctx, uint32_t word)
+{
+    if (word >= LED_MASK_WORDS)
+    {
+        return 0;
+    }
+
+    return ctx->enabled_mask[word];
+}
+
+led_status_t led_ctx_assign_sequence(led_ctx_t * ctx, int32_t led_id, int32_t sequence_id)
+{
+    // Check if LED exists
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return LED_ERR;
+    }
+
+    // Check if sequence exists
+    if(!sequence_ctx_exists(ctx->sequences, sequence_id))
+    {
+        return LED_ERR;
+    }
+
+    // Assign sequence to LED
+    state_write_begin(ctx);
+    led_assign(ctx, slot, sequence_id);
+    state_write_end(ctx);
+
+    return LED_OK;
+}
+
+led_status_t led_ctx_assign_sequence_repeat(led_ctx_t * ctx, int32_t led_id, int32_t sequence_id, uint16_t repeats, int32_t next_sequence_id)
+{
+    if (next_sequence_id != -1 && !sequence_ctx_exists(ctx->sequences, next_sequence_id))
+    {
+        return LED_ERR;
+    }
+
+    state_write_begin(ctx);
+
+    led_status_t status = led_ctx_assign_sequence(ctx, led_id, sequence_id);
+    int32_t slot = led_slot(ctx, led_id);
+
+#ifdef LED_OVERLAYS
+    if (status == LED_OK && ctx->overlay_depth[slot] > 0)
+    {
+        ctx->overlay_base[slot].repeats_left = repeats;
+        ctx->overlay_base[slot].next_sequence = repeats > 0 ? next_sequence_id : -1;
+    }
+    else
+#endif
+    if (status == LED_OK)
+    {
+        ctx->repeats_left[slot] = repeats;
+        ctx->next_sequence[slot] = repeats > 0 ? next_sequence_id : -1;
+    }
+
+    state_write_end(ctx);
+
+    return status;
+}
+
+led_status_t led_ctx_assign_sequence_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask, int32_t sequence_id)
+{
+    if (word >= LED_MASK_WORDS)
+    {
+        return LED_ERR;
+    }
+
+    // Every LED in the mask must be registered
+    if (mask & ~registered_mask(ctx, word))
+    {
+        return LED_ERR;
+    }
+
+    if(!sequence_ctx_exists(ctx->sequences, sequence_id))
+    {
+        return LED_ERR;
+    }
+
+    state_write_begin(ctx);
+
+    uint64_t remaining = mask;
+    while (remaining)
+    {
+        uint32_t i = word * 64 + mask_lowest_bit(remaining);
+        remaining &= remaining - 1;
+
+        led_assign(ctx, i, sequence_id);
+    }
+
+    state_write_end(ctx);
+
+    return LED_OK;
+}
+
+led_status_t led_ctx_update_sequence(led_ctx_t * ctx, int32_t sequence_id, sequence_t sequence)
+{
+    if (sequence_ctx_stage(ctx->sequences, sequence_id, sequence) != SEQUENCE_OK)
+    {
+        return LED_ERR;
+    }
+
+    // The LEDs are switched over by the update, which is the only place they're serviced
+    if (cmd_ring_push(ctx, LED_CMD_UPDATE_SEQUENCE, -1, sequence_id) != LED_OK)
+    {
+        sequence_ctx_discard(ctx->sequences, sequence_id);
+        return LED_ERR;
+    }
+
+    return LED_OK;
+}
+
+void led_apply_sequence_update(led_ctx_t * ctx, int32_t sequence_id)
+{
+    // Still published, the new version isn't until the LEDs have been switched over
+    const sequence_t * old = sequence_ctx_get_from_id(ctx->sequences, sequence_id);
+    const sequence_t * sequence = sequence_ctx_get_staged(ctx->sequences, sequence_id);
+
+    if (old == NULL || sequence == NULL)
+    {
+        return;
+    }
+
+    // Stepping LEDs keep showing their old state until their next step, the ones that are done 
+    // need writing again
+    for (uint32_t word = 0; word < LED_MASK_WORDS; word++)
+    {
+        uint64_t remaining = registered_mask(ctx, word);
+        while (remaining)
+        {
+            uint32_t i = word * 64 + mask_lowest_bit(remaining);
+            remaining &= remaining - 1;
+
+            led_t * led = &ctx->leds[i];
+            bool active = (ctx->active_mask[word] >> (i % 64)) & 1;
+
+            if (led->sequence_id != sequence_id)
+            {
+                continue;
+            }
+
+            if (active && sequence->length > 1 && !ctx->sequence_held[i])
+            {
+                // An LED that hasn't stepped since the last update is still showing its latched state
+                bool latched = (ctx->swap_mask[word] >> (i % 64)) & 1;
+
+                if (led->sequence_initialized && old->length > 0 && !latched)
+                {
+                    uint32_t idx = led->sequence_idx < old->length ? led->sequence_idx : old->length - 1;
+                    ctx->swap_state[i] = old->sequence[idx];
+                    ctx->swap_mask[word] |= (uint64_t)1 << (i % 64);
+                }
+                continue;
+            }
+
+            // A shorter sequence may leave the index past its end
+            if (sequence->length > 0 && led->sequence_idx >= sequence->length)
+            {
+                led->sequence_idx = sequence->length - 1;
+            }
+
+            ctx->swap_mask[word] &= ~((uint64_t)1 << (i % 64));
+            led->sequence_initialized = false;
+            active_add(ctx, i);
+        }
+    }
+
+    sequence_ctx_commit(ctx->sequences, sequence_id);
+}
+
+int32_t led_ctx_get_sequence_id(led_ctx_t * ctx, int32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return -1;
+    }
+
+    return ctx->leds[slot].sequence_id;
+}
+
+bool led_ctx_exists(led_ctx_t * ctx, int32_t led_id)
+{
+    return led_slot(ctx, led_id) != -1;
+}
+
+void led_ctx_update_state(led_ctx_t * ctx)
+{
+    led_ctx_update_begin(ctx);
+    led_ctx_update_words(ctx, 0, LED_MASK_WORDS, NULL);
+    led_ctx_update_end(ctx);
+}
+
+void led_ctx_update_begin(led_ctx_t * ctx)
+{
+    state_write_begin(ctx);
+
+    update_begin(ctx, ctx->timer_period);
+}
+
+uint32_t led_ctx_update_words(led_ctx_t * ctx, uint32_t first_word, uint32_t words, led_output_t * out)
+{
+    uint32_t outputs = 0;
+    uint32_t last_word = first_word + words < LED_MASK_WORDS ? first_word + words : LED_MASK_WORDS;
+
+    // Only LEDs that are both enabled and active have anything to do, the rest hold their last
+    // written state. Disabled LEDs hold their place in the sequence until they are enabled again.
+    for (uint32_t word = first_word; word < last_word; word++)
+    {
+#ifdef LED_BATCH
+        if (ctx->batch_update)
+        {
+            outputs += batch_update_word(ctx, word, out ? &out[outputs] : NULL);
+            continue;
+        }
+#endif
+
+        uint64_t pending = ctx->active_mask[word] & ctx->enabled_mask[word];
+
+        while (pending)
+        {
+            uint32_t i = word * 64 + mask_lowest_bit(pending);
+            pending &= pending - 1;
+
+            if (led_is_due(ctx, i) && led_service(ctx, i, out ? &out[outputs] : NULL))
+            {
+                outputs++;
+            }
+        }
+    }
+
+    return outputs;
+}
+
+void led_ctx_update_end(led_ctx_t * ctx)
+{
+    update_end(ctx);
+}
+
+void led_ctx_update_state_budget(led_ctx_t * ctx, uint32_t max_leds)
+{
+    state_write_begin(ctx);
+
+    update_begin(ctx, ctx->timer_period);
+
+    // Priority LEDs get first call on the budget, the rest share what is left round robin
+    uint32_t serviced = service_class(ctx, true, &ctx->priority_cursor, max_leds);
+    service_class(ctx, false, &ctx->normal_cursor, max_leds - serviced);
+
+    update_end(ctx);
+}
+
+void led_ctx_update_elapsed(led_ctx_t * ctx, uint32_t elapsed_ms)
+{
+    state_write_begin(ctx);
+
+    update_begin(ctx, elapsed_ms);
+
+    // Every LED whose step has come due is written in this one pass, including those that were
+    // allowed to run late so they could share the wakeup.
+    for (uint32_t word = 0; word < LED_MASK_WORDS; word++)
+    {
+        uint64_t pending = ctx->active_mask[word] & ctx->enabled_mask[word];
+
+        while (pending)
+        {
+            uint32_t i = word * 64 + mask_lowest_bit(pending);
+            pending &= pending - 1;
+
+            if ((int32_t)(led_next_step_ms(ctx, i) - ctx->now_ms) <= 0)
+            {
+                led_service(ctx, i, NULL);
+            }
+        }
+    }
+
+    update_end(ctx);
+}
+
+uint32_t led_ctx_get_next_wakeup(led_ctx_t * ctx)
+{
+    uint32_t wakeup = UINT32_MAX;
+
+    // Wake for whichever LED runs out of tolerance first, every LED due by then is serviced with it
+    for (uint32_t word = 0; word < LED_MASK_WORDS; word++)
+    {
+        uint64_t pending = ctx->active_mask[word] & ctx->enabled_mask[word];
+
+        while (pending)
+        {
+            uint32_t i = word * 64 + mask_lowest_bit(pending);
+            pending &= pending - 1;
+
+            int32_t wait = (int32_t)(led_next_step_ms(ctx, i) + ctx->tolerance_ms[i] - ctx->now_ms);
+
+            if (wait <= 0)
+            {
+                return 0;
+            }
+
+            if ((uint32_t)wait < wakeup)
+            {
+                wakeup = wait;
+            }
+        }
+    }
+
+#ifdef LED_OVERLAYS
+    // Wake to take down expiring overlays too
+    if (ctx->overlay_timed_count > 0)
+    {
+        int32_t wait = (int32_t)(ctx->overlay_next_expiry - ctx->now_ms);
+
+        if (wait <= 0)
+        {
+            return 0;
+        }
+
+        if ((uint32_t)wait < wakeup)
+        {
+            wakeup = wait;
+        }
+    }
+#endif
+
+    return wakeup;
+}
+
+void led_ctx_set_tolerance(led_ctx_t * ctx, int32_t led_id, uint16_t tolerance)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+
+    ctx->tolerance_ms[slot] = tolerance;
+}
+
+void led_ctx_set_priority(led_ctx_t * ctx, int32_t led_id, bool high_priority)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+
+    if (high_priority)
+    {
+        ctx->priority_mask[slot / 64] |= (uint64_t)1 << (slot % 64);
+    }
+    else
+    {
+        ctx->priority_mask[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+    }
+}
+
+bool led_ctx_is_priority(led_ctx_t * ctx, int32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return false;
+    }
+
+    return (ctx->priority_mask[slot / 64] >> (slot % 64)) & 1;
+}
+
+void led_ctx_set_rate_divisor(led_ctx_t * ctx, int32_t led_id, uint16_t divisor)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+
+    ctx->rate_divisor[slot] = divisor ? divisor : 1;
+    // Spread LEDs with the same divisor over different updates
+    ctx->rate_phase[slot] = slot % ctx->rate_divisor[slot];
+}
+
+void led_ctx_set_rate_divisor_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask, uint16_t divisor)
+{
+    if (word >= LED_MASK_WORDS)
+    {
+        return;
+    }
+
+    if (divisor == 0)
+    {
+        divisor = 1;
+    }
+
+    // Deal the group's LEDs out over the updates in turn so each update services an equal share
+    uint32_t n = 0;
+    uint64_t remaining = mask & registered_mask(ctx, word);
+    while (remaining)
+    {
+        uint32_t i = word * 64 + mask_lowest_bit(remaining);
+        remaining &= remaining - 1;
+
+        ctx->rate_divisor[i] = divisor;
+        ctx->rate_phase[i] = n++ % divisor;
+    }
+}
+
+uint16_t led_ctx_get_rate_divisor(led_ctx_t * ctx, int32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return 0;
+    }
+
+    return ctx->rate_divisor[slot];
+}
+
+void led_ctx_set_playback_rate(led_ctx_t * ctx, int32_t led_id, uint16_t rate)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+
+    state_write_begin(ctx);
+    ctx->playback_rate[slot] = rate;
+    state_write_end(ctx);
+}
+
+void led_ctx_set_playback_rate_mask(led_ctx_t * ctx, uint32_t word, uint64_t mask, uint16_t rate)
+{
+    if (word >= LED_MASK_WORDS)
+    {
+        return;
+    }
+
+    state_write_begin(ctx);
+
+    uint64_t remaining = mask & registered_mask(ctx, word);
+    while (remaining)
+    {
+        uint32_t i = word * 64 + mask_lowest_bit(remaining);
+        remaining &= remaining - 1;
+
+        ctx->playback_rate[i] = rate;
+    }
+
+    state_write_end(ctx);
+}
+
+uint16_t led_ctx_get_playback_rate(led_ctx_t * ctx, int32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return 0;
+    }
+
+    return ctx->playback_rate[slot];
+}
+
+void led_ctx_turn_on(led_ctx_t * ctx, int32_t led_id)
+{
+    led_ctx_assign_sequence(ctx, led_id, 1);
+}
+
+void led_ctx_turn_off(led_ctx_t * ctx, int32_t led_id)
+{
+    led_ctx_assign_sequence(ctx, led_id, 0);
+}
+
+led_t * led_ctx_get_from_id(led_ctx_t * ctx, uint32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return NULL;
+    }
+    // The enabled flag is kept in the enabled mask, refresh the copy in the LED object
+    ctx->leds[slot].enabled = (ctx->enabled_mask[slot / 64] >> (slot % 64)) & 1;
+    return &(ctx->leds[slot]);
+}
+
+void led_ctx_offset_sequence(led_ctx_t * ctx, uint32_t led_id, uint8_t seq_offset)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+    state_write_begin(ctx);
+#ifdef LED_OVERLAYS
+    if (ctx->overlay_depth[slot] > 0)
+    {
+        ctx->overlay_base[slot].led.sequence_idx = seq_offset;
+    }
+    else
+#endif
+    {
+        ctx->leds[slot].sequence_idx = seq_offset;
+        active_add(ctx, slot);
+    }
+    state_write_end(ctx);
+}
+
+led_status_t led_ctx_queue_assign_sequence(led_ctx_t * ctx, int32_t led_id, int32_t sequence_id)
+{
+    if (!led_ctx_exists(ctx, led_id) || !sequence_ctx_exists(ctx->sequences, sequence_id))
+    {
+        return LED_ERR;
+    }
+
+    return cmd_ring_push(ctx, LED_CMD_ASSIGN_SEQUENCE, led_id, sequence_id);
+}
+
+led_status_t led_ctx_queue_enable(led_ctx_t * ctx, int32_t led_id)
+{
+    if (!led_ctx_exists(ctx, led_id))
+    {
+        return LED_ERR;
+    }
+
+    return cmd_ring_push(ctx, LED_CMD_ENABLE, led_id, 0);
+}
+
+led_status_t led_ctx_queue_disable(led_ctx_t * ctx, int32_t led_id)
+{
+    if (!led_ctx_exists(ctx, led_id))
+    {
+        return LED_ERR;
+    }
+
+    return cmd_ring_push(ctx, LED_CMD_DISABLE, led_id, 0);
+}
+
+led_status_t led_ctx_queue_offset_sequence(led_ctx_t * ctx, int32_t led_id, uint8_t seq_offset)
+{
+    if (!led_ctx_exists(ctx, led_id))
+    {
+        return LED_ERR;
+    }
+
+    return cmd_ring_push(ctx, LED_CMD_OFFSET_SEQUENCE, led_id, seq_offset);
+}
+
+led_status_t led_ctx_read_snapshot(led_ctx_t * ctx, int32_t led_id, led_t * out)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1 || out == NULL)
+    {
+        return LED_ERR;
+    }
+
+    for (uint32_t attempt = 0; attempt < LED_SNAPSHOT_RETRIES; attempt++)
+    {
+        uint32_t start = __atomic_load_n(&ctx->state_seq, __ATOMIC_ACQUIRE);
+
+        if (start & 1)
+        {
+            // A change is in progress
+            continue;
+        }
+
+        memcpy(out, &ctx->leds[slot], sizeof(led_t));
+        out->enabled = (ctx->enabled_mask[slot / 64] >> (slot % 64)) & 1;
+
+        // Keep the copy before the second read of the counter
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&ctx->state_seq, __ATOMIC_RELAXED) == start)
+        {
+            return LED_OK;
+        }
+    }
+
+    return LED_ERR;
+}
+
+int32_t led_ctx_read_table(led_ctx_t * ctx, led_t * out, uint32_t max)
+{
+    if (out == NULL)
+    {
+        return -1;
+    }
+
+    for (uint32_t attempt = 0; attempt < LED_SNAPSHOT_RETRIES; attempt++)
+    {
+        uint32_t start = __atomic_load_n(&ctx->state_seq, __ATOMIC_ACQUIRE);
+
+        if (start & 1)
+        {
+            continue;
+        }
+
+        uint32_t copied = ctx->count < max ? ctx->count : max;
+
+        memcpy(out, ctx->leds, copied * sizeof(led_t));
+        for (uint32_t i = 0; i < copied; i++)
+        {
+            out[i].enabled = (ctx->enabled_mask[i / 64] >> (i % 64)) & 1;
+
+            if ((ctx->free_mask[i / 64] >> (i % 64)) & 1)
+            {
+                out[i].sequence_id = LED_SLOT_FREE;
+            }
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&ctx->state_seq, __ATOMIC_RELAXED) == start)
+        {
+            return copied;
+        }
+    }
+
+    return -1;
+}
+
+#ifdef LED_OVERLAYS
+led_status_t led_ctx_push_overlay(led_ctx_t * ctx, int32_t led_id, int32_t sequence_id, uint8_t priority, uint32_t duration_ms)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1 || !sequence_ctx_exists(ctx->sequences, sequence_id))
+    {
+        return LED_ERR;
+    }
+
+    if (ctx->overlay_depth[slot] >= LED_OVERLAY_DEPTH)
+    {
+        return LED_ERR;
+    }
+
+    state_write_begin(ctx);
+
+    led_overlay_t * overlays = ctx->overlays[slot];
+    uint32_t depth = ctx->overlay_depth[slot];
+
+    if (depth == 0)
+    {
+        // Keep the assigned sequence and where it's up to for when the overlays are gone
+        led_overlay_base_t * base = &ctx->overlay_base[slot];
+
+        base->led = ctx->leds[slot];
+        base->serviced_ms = ctx->serviced_ms[slot];
+        base->repeats_left = ctx->repeats_left[slot];
+        base->next_sequence = ctx->next_sequence[slot];
+        base->held = ctx->sequence_held[slot];
+    }
+
+    // Above every overlay of the same or lower priority
+    uint32_t position = depth;
+    while (position > 0 && overlays[position - 1].priority > priority)
+    {
+        overlays[position] = overlays[position - 1];
+        position--;
+    }
+
+    overlays[position].sequence_id = sequence_id;
+    overlays[position].priority = priority;
+    overlays[position].timed = duration_ms > 0;
+    overlays[position].expires_ms = ctx->now_ms + duration_ms;
+    ctx->overlay_depth[slot] = depth + 1;
+
+    if (duration_ms > 0)
+    {
+        if (ctx->overlay_timed_count == 0 || (int32_t)(overlays[position].expires_ms - ctx->overlay_next_expiry) < 0)
+        {
+            ctx->overlay_next_expiry = overlays[position].expires_ms;
+        }
+        ctx->overlay_timed_count++;
+        ctx->overlay_timed_mask[slot / 64] |= (uint64_t)1 << (slot % 64);
+    }
+
+    if (position == depth)
+    {
+        led_show_sequence(ctx, slot, sequence_id);
+    }
+
+    state_write_end(ctx);
+
+    return LED_OK;
+}
+
+led_status_t led_ctx_pop_overlay(led_ctx_t * ctx, int32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1 || ctx->overlay_depth[slot] == 0)
+    {
+        return LED_ERR;
+    }
+
+    state_write_begin(ctx);
+    overlay_remove(ctx, slot, ctx->overlay_depth[slot] - 1);
+    state_write_end(ctx);
+
+    return LED_OK;
+}
+
+void led_ctx_clear_overlays(led_ctx_t * ctx, int32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+
+    state_write_begin(ctx);
+    while (ctx->overlay_depth[slot] > 0)
+    {
+        overlay_remove(ctx, slot, ctx->overlay_depth[slot] - 1);
+    }
+    state_write_end(ctx);
+}
+
+uint32_t led_ctx_get_overlay_count(led_ctx_t * ctx, int32_t led_id)
+{
+    int32_t slot = led_slot(ctx, led_id);
+
+    if (slot == -1)
+    {
+        return 0;
+    }
+
+    return ctx->overlay_depth[slot];
+}
+#endif
+
+void led_ctx_set_event_callback(led_ctx_t * ctx, led_event_fn_t callback)
+{
+    ctx->event_callback = callback;
+}
+
+uint32_t led_ctx_dispatch_events(led_ctx_t * ctx)
+{
+    uint32_t calls = 0;
+    led_event_fn_t callback = ctx->event_callback;
+
+    if (callback == NULL)
+    {
+        return 0;
+    }
+
+    for (uint32_t event = 0; event < LED_EVENT_COUNT; event++)
+    {
+        for (uint32_t word = 0; word < LED_MASK_WORDS; word++)
+        {
+            // Take the word and clear it in one go so events raised meanwhile aren't lost
+            uint64_t mask = __atomic_exchange_n(&ctx->event_masks[event][word], 0, __ATOMIC_ACQUIRE);
+
+            if (mask)
+            {
+                callback((led_event_t)event, word, mask);
+                calls++;
+            }
+        }
+    }
+
+    return calls;
+}
+
+#ifdef LED_TRACE
+int32_t led_ctx_read_trace(led_ctx_t * ctx, led_trace_entry_t * out, uint32_t max)
+{
+    if (out == NULL)
+    {
+        return -1;
+    }
+
+    for (uint32_t attempt = 0; attempt < LED_SNAPSHOT_RETRIES; attempt++)
+    {
+        uint32_t start = __atomic_load_n(&ctx->state_seq, __ATOMIC_ACQUIRE);
+
+        if (start & 1)
+        {
+            continue;
+        }
+
+        uint32_t count = ctx->trace_count;
+        uint32_t copied = count < LED_TRACE_SIZE ? count : LED_TRACE_SIZE;
+        copied = copied < max ? copied : max;
+
+        // The newest entries are kept if they don't all fit
+        for (uint32_t n = 0; n < copied; n++)
+        {
+            out[n] = ctx->trace[(count - copied + n) & (LED_TRACE_SIZE - 1)];
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&ctx->state_seq, __ATOMIC_RELAXED) == start)
+        {
+            return copied;
+        }
+    }
+
+    return -1;
+}
+
+uint32_t led_ctx_get_trace_count(led_ctx_t * ctx)
+{
+    return __atomic_load_n(&ctx->trace_count, __ATOMIC_RELAXED);
+}
+
+void led_ctx_clear_trace(led_ctx_t * ctx)
+{
+    state_write_begin(ctx);
+    ctx->trace_count = 0;
+    state_write_end(ctx);
+}
+#endif
+
+#ifdef LED_INSTRUMENTATION
+void led_ctx_set_cycle_counter(led_ctx_t * ctx, led_cycle_counter_fn_t counter, uint32_t budget)
+{
+    state_write_begin(ctx);
+    ctx->cycle_counter = counter;
+    ctx->cycle_budget = budget;
+    state_write_end(ctx);
+}
+
+led_status_t led_ctx_get_stats(led_ctx_t * ctx, led_stats_t * out)
+{
+    if (out == NULL)
+    {
+        return LED_ERR;
+    }
+
+    for (uint32_t attempt = 0; attempt < LED_SNAPSHOT_RETRIES; attempt++)
+    {
+        uint32_t start = __atomic_load_n(&ctx->state_seq, __ATOMIC_ACQUIRE);
+
+        if (start & 1)
+        {
+            continue;
+        }
+
+        memcpy(out, &ctx->stats, sizeof(led_stats_t));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&ctx->state_seq, __ATOMIC_RELAXED) == start)
+        {
+            out->mean_cycles = out->calls ? out->total_cycles / out->calls : 0;
+            return LED_OK;
+        }
+    }
+
+    return LED_ERR;
+}
+
+void led_ctx_reset_stats(led_ctx_t * ctx)
+{
+    state_write_begin(ctx);
+    memset(&ctx->stats, 0, sizeof(led_stats_t));
+    state_write_end(ctx);
+}
+#endif
+
+/*******************************/
+/* PUBLIC FUNCTION DEFINITIONS */
+/*******************************/
+
+void led_init(uint32_t _timer_period)
+{
+    led_ctx_init(&led_default_ctx, sequence_get_default_ctx(), _timer_period);
+
+    // The default scenes are applied by the default context's updates
+    scene_init();
+}
+
+uint32_t led_get_count()
+{
+    return led_ctx_get_count(&led_default_ctx);
+}
+
+void led_on(int32_t id)
+{
+    led_ctx_on(&led_default_ctx, id);
+}
+
+void led_off(int32_t id)
+{
+    led_ctx_off(&led_default_ctx, id);
+}
+
+int32_t led_register(led_t led_obj)
+{
+    return led_ctx_register(&led_default_ctx, led_obj);
+}
+
+led_status_t led_unregister(int32_t led_id)
+{
+    return led_ctx_unregister(&led_default_ctx, led_id);
+}
+
+void led_disable(int32_t id)
+{
+    led_ctx_disable(&led_default_ctx, id);
+}
+
+void led_enable(int32_t id)
+{
+    led_ctx_enable(&led_default_ctx, id);
+}
+
+bool led_is_enabled(int32_t id)
+{
+    return led_ctx_is_enabled(&led_default_ctx, id);
+}
+
+void led_enable_mask(uint32_t word, uint64_t mask)
+{
+    led_ctx_enable_mask(&led_default_ctx, word, mask);
+}
+
+void led_disable_mask(uint32_t word, uint64_t mask)
+{
+    led_ctx_disable_mask(&led_default_ctx, word, mask);
+}
+
+uint64_t led_get_enabled_mask(uint32_t word)
+{
+    return led_ctx_get_enabled_mask(&led_default_ctx, word);
+}
+
+led_status_t led_assign_sequence(int32_t led_id, int32_t sequence_id)
+{
+    return led_ctx_assign_sequence(&led_default_ctx, led_id, sequence_id);
+}
+
+led_status_t led_assign_sequence_repeat(int32_t led_id, int32_t sequence_id, uint16_t repeats, int32_t next_sequence_id)
+{
+    return led_ctx_assign_sequence_repeat(&led_default_ctx, led_id, sequence_id, repeats, next_sequence_id);
+}
+
+led_status_t led_update_sequence(int32_t sequence_id, sequence_t sequence)
+{
+    return led_ctx_update_sequence(&led_default_ctx, sequence_id, sequence);
+}
+
+led_status_t led_assign_sequence_mask(uint32_t word, uint64_t mask, int32_t sequence_id)
+{
+    return led_ctx_assign_sequence_mask(&led_default_ctx, word, mask, sequence_id);
+}
+
+int32_t led_get_sequence_id(int32_t led_id)
+{
+    return led_ctx_get_sequence_id(&led_default_ctx, led_id);
+}
+
+bool led_exists(int32_t led_id)
+{
+    return led_ctx_exists(&led_default_ctx, led_id);
+}
+
+void led_update_state()
+{
+    led_ctx_update_state(&led_default_ctx);
+}
+
+void led_update_state_budget(uint32_t max_leds)
+{
+    led_ctx_update_state_budget(&led_default_ctx, max_leds);
+}
+
+void led_update_elapsed(uint32_t elapsed_ms)
+{
+    led_ctx_update_elapsed(&led_default_ctx, elapsed_ms);
+}
+
+uint32_t led_get_next_wakeup()
+{
+    return led_ctx_get_next_wakeup(&led_default_ctx);
+}
+
+void led_set_tolerance(int32_t led_id, uint16_t tolerance)
+{
+    led_ctx_set_tolerance(&led_default_ctx, led_id, tolerance);
+}
+
+void led_set_priority(int32_t led_id, bool high_priority)
+{
+    led_ctx_set_priority(&led_default_ctx, led_id, high_priority);
+}
+
+bool led_is_priority(int32_t led_id)
+{
+    return led_ctx_is_priority(&led_default_ctx, led_id);
+}
+
+void led_set_rate_divisor(int32_t led_id, uint16_t divisor)
+{
+    led_ctx_set_rate_divisor(&led_default_ctx, led_id, divisor);
+}
+
+void led_set_rate_divisor_mask(uint32_t word, uint64_t mask, uint16_t divisor)
+{
+    led_ctx_set_rate_divisor_mask(&led_default_ctx, word, mask, divisor);
+}
+
+uint16_t led_get_rate_divisor(int32_t led_id)
+{
+    return led_ctx_get_rate_divisor(&led_default_ctx, led_id);
+}
+
+void led_set_playback_rate(int32_t led_id, uint16_t rate)
+{
+    led_ctx_set_playback_rate(&led_default_ctx, led_id, rate);
+}
+
+void led_set_playback_rate_mask(uint32_t word, uint64_t mask, uint16_t rate)
+{
+    led_ctx_set_playback_rate_mask(&led_default_ctx, word, mask, rate);
+}
+
+uint16_t led_get_playback_rate(int32_t led_id)
+{
+    return led_ctx_get_playback_rate(&led_default_ctx, led_id);
+}
+
+void led_turn_on(int32_t led_id)
+{
+    led_ctx_turn_on(&led_default_ctx, led_id);
+}
+
+void led_turn_off(int32_t led_id)
+{
+    led_ctx_turn_off(&led_default_ctx, led_id);
+}
+
+void led_print(int32_t id)
+{
+    led_t * leds = led_default_ctx.leds;
+    int32_t slot = led_slot(&led_default_ctx, id);
+
+    if (slot == -1)
+    {
+        printf("id: %d is not a registered LED\n", (int)id);
+        return;
+    }
+
+    printf( "id: %d\n"
+            "enabled: %d\n"
+            "pinout: ..\n"
+            "sequence_id: %d\n"
+            "sequence_idx: %d\n"
+            "timer_count: %d\n", (int)id, led_is_enabled(id), (int)leds[slot].sequence_id, leds[slot].sequence_idx, (int)leds[slot].timer_count);
+}
+
+led_t * led_get_from_id(uint32_t led_id)
+{
+    return led_ctx_get_from_id(&led_default_ctx, led_id);
+}
+
+void led_offset_sequence(uint32_t led_id, uint8_t seq_offset)
+{
+    led_ctx_offset_sequence(&led_default_ctx, led_id, seq_offset);
+}
+
+led_status_t led_queue_assign_sequence(int32_t led_id, int32_t sequence_id)
+{
+    return led_ctx_queue_assign_sequence(&led_default_ctx, led_id, sequence_id);
+}
+
+led_status_t led_queue_enable(int32_t led_id)
+{
+    return led_ctx_queue_enable(&led_default_ctx, led_id);
+}
+
+led_status_t led_queue_disable(int32_t led_id)
+{
+    return led_ctx_queue_disable(&led_default_ctx, led_id);
+}
+
+led_status_t led_queue_offset_sequence(int32_t led_id, uint8_t seq_offset)
+{
+    return led_ctx_queue_offset_sequence(&led_default_ctx, led_id, seq_offset);
+}
+
+led_status_t led_read_snapshot(int32_t led_id, led_t * out)
+{
+    return led_ctx_read_snapshot(&led_default_ctx, led_id, out);
+}
+
+int32_t led_read_table(led_t * out, uint32_t max)
+{
+    return led_ctx_read_table(&led_default_ctx, out, max);
+}
+
+#ifdef LED_OVERLAYS
+led_status_t led_push_overlay(int32_t led_id, int32_t sequence_id, uint8_t priority, uint32_t duration_ms)
+{
+    return led_ctx_push_overlay(&led_default_ctx, led_id, sequence_id, priority, duration_ms);
+}
+
+led_status_t led_pop_overlay(int32_t led_id)
+{
+    return led_ctx_pop_overlay(&led_default_ctx, led_id);
+}
+
+void led_clear_overlays(int32_t led_id)
+{
+    led_ctx_clear_overlays(&led_default_ctx, led_id);
+}
+
+uint32_t led_get_overlay_count(int32_t led_id)
+{
+    return led_ctx_get_overlay_count(&led_default_ctx, led_id);
+}
+#endif
+
+void led_set_event_callback(led_event_fn_t callback)
+{
+    led_ctx_set_event_callback(&led_default_ctx, callback);
+}
+
+uint32_t led_dispatch_events()
+{
+    return led_ctx_dispatch_events(&led_default_ctx);
+}
+
+#ifdef LED_INSTRUMENTATION
+void led_set_cycle_counter(led_cycle_counter_fn_t counter, uint32_t budget)
+{
+    led_ctx_set_cycle_counter(&led_default_ctx, counter, budget);
+}
+
+led_status_t led_get_stats(led_stats_t * out)
+{
+    return led_ctx_get_stats(&led_default_ctx, out);
+}
+
+void led_reset_stats()
+{
+    led_ctx_reset_stats(&led_default_ctx);
+}
+#endif
+
+#ifdef LED_TRACE
+int32_t led_read_trace(led_trace_entry_t * out, uint32_t max)
+{
+    return led_ctx_read_trace(&led_default_ctx, out, max);
+}
+
+uint32_t led_get_trace_count()
+{
+    return led_ctx_get_trace_count(&led_default_ctx);
+}
+
+void led_clear_trace()
+{
+    led_ctx_clear_trace(&led_default_ctx);
 }
+#endif
@@ -0,0 +1,142 @@
+#include "led_batch.h"
+
+#ifdef LED_BATCH
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*******************************/
+/* PRIVATE FUNCTION PROTOTYPES */
+/*******************************/
+
+#if defined(__AVX2__)
+/**
+ * @brief Advances the LEDs 8 at a time.
+ *
+ * @return uint32_t - number of LEDs advanced, the rest are left for the scalar loop.
+ */
+uint32_t batch_advance_avx2(led_batch_t * batch, uint32_t elapsed, const uint8_t * table);
+#elif defined(__SSE2__)
+/**
+ * @brief Advances the LEDs 4 at a time.
+ *
+ * @return uint32_t - number of LEDs advanced, the rest are left for the scalar loop.
+ */
+uint32_t batch_advance_sse2(led_batch_t * batch, uint32_t elapsed, const uint8_t * table);
+#endif
+
+/********************************/
+/* PRIVATE FUNCTION DEFINITIONS */
+/********************************/
+
+#if defined(__AVX2__)
+uint32_t batch_advance_avx2(led_batch_t * batch, uint32_t elapsed, const uint8_t * table)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i sign = _mm256_set1_epi32((int32_t)0x80000000);
+    const __m256i byte = _mm256_set1_epi32(0xFF);
+    const __m256i add = _mm256_set1_epi32((int32_t)elapsed);
+    uint32_t i = 0;
+
+    for (; i + 8 <= batch->count; i += 8)
+    {
+        __m256i tc = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&batch->timer_count[i]), add);
+        __m256i step = _mm256_loadu_si256((const __m256i *)&batch->step_ms[i]);
+        __m256i idx = _mm256_loadu_si256((const __m256i *)&batch->idx[i]);
+        __m256i length = _mm256_loadu_si256((const __m256i *)&batch->length[i]);
+        __m256i offset = _mm256_loadu_si256((const __m256i *)&batch->seq_offset[i]);
+
+        // Unsigned tc >= step, flipping the sign bits turns it into a signed compare
+        __m256i due = _mm256_xor_si256(_mm256_cmpgt_epi32(_mm256_xor_si256(step, sign), _mm256_xor_si256(tc, sign)), _mm256_set1_epi32(-1));
+
+        tc = _mm256_sub_epi32(tc, _mm256_and_si256(step, due));
+
+        // Step forward one, wrapping at the end of the sequence
+        __m256i next = _mm256_add_epi32(idx, one);
+        next = _mm256_and_si256(_mm256_cmpgt_epi32(length, next), next);
+        idx = _mm256_blendv_epi8(idx, next, due);
+
+        // Each lane reads 4 bytes from its state, keep the first
+        __m256i state = _mm256_i32gather_epi32((const int *)table, _mm256_add_epi32(offset, idx), 1);
+
+        _mm256_storeu_si256((__m256i *)&batch->timer_count[i], tc);
+        _mm256_storeu_si256((__m256i *)&batch->idx[i], idx);
+        _mm256_storeu_si256((__m256i *)&batch->state[i], _mm256_and_si256(state, byte));
+    }
+
+    return i;
+}
+#elif defined(__SSE2__)
+uint32_t batch_advance_sse2(led_batch_t * batch, uint32_t elapsed, const uint8_t * table)
+{
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i sign = _mm_set1_epi32((int32_t)0x80000000);
+    const __m128i add = _mm_set1_epi32((int32_t)elapsed);
+    uint32_t i = 0;
+
+    for (; i + 4 <= batch->count; i += 4)
+    {
+        __m128i tc = _mm_add_epi32(_mm_loadu_si128((const __m128i *)&batch->timer_count[i]), add);
+        __m128i step = _mm_loadu_si128((const __m128i *)&batch->step_ms[i]);
+        __m128i idx = _mm_loadu_si128((const __m128i *)&batch->idx[i]);
+        __m128i length = _mm_loadu_si128((const __m128i *)&batch->length[i]);
+
+        // Unsigned tc >= step, flipping the sign bits turns it into a signed compare
+        __m128i due = _mm_xor_si128(_mm_cmpgt_epi32(_mm_xor_si128(step, sign), _mm_xor_si128(tc, sign)), _mm_set1_epi32(-1));
+
+        tc = _mm_sub_epi32(tc, _mm_and_si128(step, due));
+
+        // Step forward one, wrapping at the end of the sequence
+        __m128i next = _mm_add_epi32(idx, one);
+        next = _mm_and_si128(_mm_cmpgt_epi32(length, next), next);
+        idx = _mm_or_si128(_mm_and_si128(due, next), _mm_andnot_si128(due, idx));
+
+        _mm_storeu_si128((__m128i *)&batch->timer_count[i], tc);
+        _mm_storeu_si128((__m128i *)&batch->idx[i], idx);
+
+        // SSE2 has no gather
+        for (uint32_t lane = i; lane < i + 4; lane++)
+        {
+            batch->state[lane] = table[batch->seq_offset[lane] + batch->idx[lane]];
+        }
+    }
+
+    return i;
+}
+#endif
+
+/*******************************/
+/* PUBLIC FUNCTION DEFINITIONS */
+/*******************************/
+
+void led_batch_advance(led_batch_t * batch, uint32_t elapsed, const uint8_t * table)
+{
+    uint32_t done = 0;
+
+#if defined(__AVX2__)
+    done = batch_advance_avx2(batch, elapsed, table);
+#elif defined(__SSE2__)
+    done = batch_advance_sse2(batch, elapsed, table);
+#endif
+
+    led_batch_advance_scalar(batch, done, elapsed, table);
+}
+
+void led_batch_advance_scalar(led_batch_t * batch, uint32_t first, uint32_t elapsed, const uint8_t * table)
+{
+    for (uint32_t i = first; i < batch->count; i++)
+    {
+        batch->timer_count[i] += elapsed;
+
+        if (batch->timer_count[i] >= batch->step_ms[i])
+        {
+            batch->timer_count[i] -= batch->step_ms[i];
+            batch->idx[i] = batch->idx[i] + 1 < batch->length[i] ? batch->idx[i] + 1 : 0;
+        }
+
+        batch->state[i] = table[batch->seq_offset[i] + batch->idx[i]];
+    }
+}
+
+#endif
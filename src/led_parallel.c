@@ -0,0 +1,168 @@
+#include "led_parallel.h"
+
+#ifdef LED_PARALLEL
+
+/*******************************/
+/* PRIVATE FUNCTION PROTOTYPES */
+/*******************************/
+
+/**
+ * @brief Claims and updates chunks of the pool's context until there are none left.
+ */
+void pool_run_chunks(led_pool_t * pool);
+
+/**
+ * @brief Body of each worker thread, runs its share of every update until the pool stops.
+ */
+void * pool_worker(void * arg);
+
+/********************************/
+/* PRIVATE FUNCTION DEFINITIONS */
+/********************************/
+
+void pool_run_chunks(led_pool_t * pool)
+{
+    for (;;)
+    {
+        uint32_t chunk = __atomic_fetch_add(&pool->next_chunk, 1, __ATOMIC_RELAXED);
+
+        if (chunk >= LED_PARALLEL_CHUNKS)
+        {
+            return;
+        }
+
+        uint32_t first_word = chunk * LED_PARALLEL_CHUNK_WORDS;
+
+        // Chunks are whole mask words, so no two threads touch the same LED or mask word
+        pool->chunk_outputs[chunk] = led_ctx_update_words(pool->ctx, first_word, LED_PARALLEL_CHUNK_WORDS, &pool->outputs[first_word * 64]);
+    }
+}
+
+void * pool_worker(void * arg)
+{
+    led_pool_t * pool = arg;
+    uint32_t generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (;;)
+    {
+        while (pool->generation == generation && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+
+        if (pool->stopping)
+        {
+            break;
+        }
+
+        generation = pool->generation;
+
+        pthread_mutex_unlock(&pool->lock);
+        pool_run_chunks(pool);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->running == 0)
+        {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/*******************************/
+/* PUBLIC FUNCTION DEFINITIONS */
+/*******************************/
+
+led_status_t led_pool_init(led_pool_t * pool, uint32_t threads)
+{
+    if (threads > LED_PARALLEL_MAX_THREADS)
+    {
+        return LED_ERR;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->generation = 0;
+    pool->running = 0;
+    pool->stopping = false;
+    pool->ctx = NULL;
+    pool->thread_count = 0;
+
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0)
+        {
+            led_pool_destroy(pool);
+            return LED_ERR;
+        }
+
+        pool->thread_count++;
+    }
+
+    return LED_OK;
+}
+
+void led_pool_destroy(led_pool_t * pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pool->thread_count = 0;
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+void led_ctx_update_state_parallel(led_ctx_t * ctx, led_pool_t * pool)
+{
+    led_ctx_update_begin(ctx);
+
+    // Start the workers on this update, the mutex publishes the context to them
+    pthread_mutex_lock(&pool->lock);
+    pool->ctx = ctx;
+    __atomic_store_n(&pool->next_chunk, 0, __ATOMIC_RELAXED);
+    pool->running = pool->thread_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Take a share rather than sit idle
+    pool_run_chunks(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+    {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    // Write the chunks in order so the hardware sees the same sequence of writes as a serial update
+    for (uint32_t chunk = 0; chunk < LED_PARALLEL_CHUNKS; chunk++)
+    {
+        led_output_t * outputs = &pool->outputs[chunk * LED_PARALLEL_CHUNK_WORDS * 64];
+
+        for (uint32_t i = 0; i < pool->chunk_outputs[chunk]; i++)
+        {
+            ctx->write(outputs[i].pinout, outputs[i].state);
+        }
+    }
+
+    led_ctx_update_end(ctx);
+}
+
+#endif
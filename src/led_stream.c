@@ -0,0 +1,217 @@
+#include "led_stream.h"
+#include <stddef.h>
+
+// The context used by the functions without a context.
+static led_stream_ctx_t led_stream_default_ctx = {0};
+
+/**
+ * @brief Fills the stream's next half from the producer, or with the last state once the stream has
+ * ended, and moves on to the other half.
+ */
+static void stream_fill_half(led_stream_t * stream, int32_t stream_id)
+{
+    uint8_t * states = &stream->buffer.sequence[stream->fill_half * stream->half];
+    uint32_t count = 0;
+
+    if (stream->state == LED_STREAM_PLAYING)
+    {
+        count = stream->fill(stream_id, states, stream->half);
+
+        if (count > stream->half)
+        {
+            count = stream->half;
+        }
+
+        if (count > 0)
+        {
+            stream->last_state = states[count - 1];
+        }
+
+        if (count < stream->half)
+        {
+            stream->state = LED_STREAM_DRAINING;
+            stream->end_half = stream->fill_half;
+            stream->end_idx = stream->fill_half * stream->half + count;
+        }
+    }
+
+    // After the end the LED only ever shows the last state
+    for (uint32_t i = count; i < stream->half; i++)
+    {
+        states[i] = stream->last_state;
+    }
+
+    stream->fill_half ^= 1;
+}
+
+led_stream_ctx_t * led_stream_get_default_ctx()
+{
+    return &led_stream_default_ctx;
+}
+
+void led_stream_ctx_init(led_stream_ctx_t * ctx, led_ctx_t * led_ctx)
+{
+    for (int i = 0; i < MAX_STREAMS; i++)
+    {
+        ctx->streams[i].state = LED_STREAM_CLOSED;
+        ctx->streams[i].sequence_id = -1;
+    }
+
+    ctx->led = led_ctx;
+}
+
+int32_t led_stream_ctx_open(led_stream_ctx_t * ctx, int32_t led_id, uint8_t half, uint32_t step_ms, led_stream_fill_fn_t fill)
+{
+    if (!led_ctx_exists(ctx->led, led_id) || half == 0 || half > LED_STREAM_HALF_MAX || fill == NULL)
+    {
+        return -1;
+    }
+
+    int32_t stream_id = 0;
+    while (stream_id < MAX_STREAMS && ctx->streams[stream_id].state != LED_STREAM_CLOSED)
+    {
+        stream_id++;
+    }
+
+    if (stream_id == MAX_STREAMS)
+    {
+        return -1;
+    }
+
+    led_stream_t * stream = &ctx->streams[stream_id];
+    stream->state = LED_STREAM_PLAYING;
+    stream->fill = fill;
+    stream->led_id = led_id;
+    stream->half = half;
+    stream->fill_half = 0;
+    stream->unpublished = false;
+    stream->last_state = LED_OFF;
+    stream->buffer.length = 2 * half;
+    stream->buffer.period = step_ms * 2 * half;
+
+    stream_fill_half(stream, stream_id);
+    stream_fill_half(stream, stream_id);
+
+    // The content changes under the LED, so the sequence mustn't be shared with anyone else's
+    stream->sequence_id = sequence_ctx_register_unique(ctx->led->sequences, stream->buffer);
+
+    if (stream->sequence_id == -1)
+    {
+        stream->state = LED_STREAM_CLOSED;
+        return -1;
+    }
+
+    led_ctx_assign_sequence(ctx->led, led_id, stream->sequence_id);
+
+    return stream_id;
+}
+
+void led_stream_ctx_service(led_stream_ctx_t * ctx)
+{
+    for (int32_t stream_id = 0; stream_id < MAX_STREAMS; stream_id++)
+    {
+        led_stream_t * stream = &ctx->streams[stream_id];
+
+        if (stream->state != LED_STREAM_PLAYING && stream->state != LED_STREAM_DRAINING)
+        {
+            continue;
+        }
+
+        // The snapshot doesn't race with the update, left alone once the LED shows something else
+        led_t led;
+
+        if (led_ctx_read_snapshot(ctx->led, stream->led_id, &led) != LED_OK || led.sequence_id != stream->sequence_id)
+        {
+            continue;
+        }
+
+        uint8_t cursor_half = led.sequence_idx / stream->half;
+        bool draining = stream->state == LED_STREAM_DRAINING && !stream->unpublished;
+        bool padded = draining && stream->fill_half == stream->end_half;
+
+        // Done once the LED has passed the last state, or left the half it's in for one only holding it
+        if ((draining && cursor_half == stream->end_half && led.sequence_idx >= stream->end_idx) ||
+            (padded && cursor_half != stream->end_half))
+        {
+            sequence_t last = {.sequence = {stream->last_state}, .length = 1, .period = stream->buffer.period};
+
+            if (led_ctx_update_sequence(ctx->led, stream->sequence_id, last) == LED_OK)
+            {
+                stream->state = LED_STREAM_FINISHED;
+            }
+            continue;
+        }
+
+        // The half being filled is the one the LED has just left, it has a whole half to get back to it
+        if (cursor_half != stream->fill_half && !(stream->state == LED_STREAM_DRAINING && stream->fill_half == stream->end_half))
+        {
+            stream_fill_half(stream, stream_id);
+            stream->unpublished = true;
+        }
+
+        // Published by the next update, until then or with no spare buffer it's tried again next time
+        if (stream->unpublished && led_ctx_update_sequence(ctx->led, stream->sequence_id, stream->buffer) == LED_OK)
+        {
+            stream->unpublished = false;
+        }
+    }
+}
+
+led_stream_state_t led_stream_ctx_get_state(led_stream_ctx_t * ctx, int32_t stream_id)
+{
+    if (stream_id < 0 || stream_id >= MAX_STREAMS)
+    {
+        return LED_STREAM_CLOSED;
+    }
+
+    return ctx->streams[stream_id].state;
+}
+
+led_status_t led_stream_ctx_close(led_stream_ctx_t * ctx, int32_t stream_id)
+{
+    if (led_stream_ctx_get_state(ctx, stream_id) == LED_STREAM_CLOSED)
+    {
+        return LED_ERR;
+    }
+
+    led_stream_t * stream = &ctx->streams[stream_id];
+    led_t led;
+
+    // Turned off by the next update, before it could find the sequence gone
+    if (led_ctx_read_snapshot(ctx->led, stream->led_id, &led) == LED_OK && led.sequence_id == stream->sequence_id &&
+        led_ctx_queue_assign_sequence(ctx->led, stream->led_id, 0) != LED_OK)
+    {
+        return LED_ERR;
+    }
+
+    sequence_ctx_unregister(ctx->led->sequences, stream->sequence_id);
+    stream->sequence_id = -1;
+    stream->state = LED_STREAM_CLOSED;
+
+    return LED_OK;
+}
+
+void led_stream_init()
+{
+    led_stream_ctx_init(&led_stream_default_ctx, led_get_default_ctx());
+}
+
+int32_t led_stream_open(int32_t led_id, uint8_t half, uint32_t step_ms, led_stream_fill_fn_t fill)
+{
+    return led_stream_ctx_open(&led_stream_default_ctx, led_id, half, step_ms, fill);
+}
+
+void led_stream_service()
+{
+    led_stream_ctx_service(&led_stream_default_ctx);
+}
+
+led_stream_state_t led_stream_get_state(int32_t stream_id)
+{
+    return led_stream_ctx_get_state(&led_stream_default_ctx, stream_id);
+}
+
+led_status_t led_stream_close(int32_t stream_id)
+{
+    return led_stream_ctx_close(&led_stream_default_ctx, stream_id);
+}
@@ -2,11 +2,8 @@
 #include <string.h>
 #include <stdio.h>
 
-rgb_led_t rgbLeds[LEDS_MAX] = {0};
-rgb_sequence_t rgbSequences[MAX_SEQUENCES] = {0};
-
-static uint32_t rgb_led_count = 0; /** Number of registered RGB Leds*/
-static uint32_t rgb_seq_count = 0; /** Number of registered RGB sequences*/
+// The context used by the functions without a context.
+static rgb_ctx_t rgb_default_ctx = {0};
 
 /**
  * @brief Predefined hexidecimal colour codes to be used for sequence creation
@@ -20,123 +17,149 @@ typedef enum
     C_OFF = 0x000000,
 } rgb_colour_t;
 
-void rgb_led_init()
+rgb_ctx_t * rgb_get_default_ctx()
+{
+    return &rgb_default_ctx;
+}
+
+void rgb_ctx_init(rgb_ctx_t * ctx, led_ctx_t * led_ctx)
 {
-    rgb_led_count = 0;
-    rgb_seq_count = 0;
+    ctx->led = led_ctx;
+    ctx->led_count = 0;
+    ctx->seq_count = 0;
     // Registering base Sequences 
     uint32_t seq[1] = {C_WHITE};
-    rgb_sequence_register(1, 1, seq);
+    rgb_ctx_sequence_register(ctx, 1, 1, seq);
     seq[0] = C_RED;
-    rgb_sequence_register(1, 1, seq);
+    rgb_ctx_sequence_register(ctx, 1, 1, seq);
     seq[0] = C_GREEN;
-    rgb_sequence_register(1, 1, seq);
+    rgb_ctx_sequence_register(ctx, 1, 1, seq);
     seq[0] = C_BLUE;
-    rgb_sequence_register(1, 1, seq);
+    rgb_ctx_sequence_register(ctx, 1, 1, seq);
     seq[0] = C_OFF;
-    rgb_sequence_register(1, 1, seq);
+    rgb_ctx_sequence_register(ctx, 1, 1, seq);
 }
 
-
-uint32_t rgb_led_get_count()
+uint32_t rgb_ctx_led_get_count(rgb_ctx_t * ctx)
 {
-    return rgb_led_count;  
+    return ctx->led_count;
 }
 
-led_status_t rgb_led_on(int32_t id, rgb_state_t existing_sequence)
+led_status_t rgb_ctx_led_on(rgb_ctx_t * ctx, int32_t id, rgb_state_t existing_sequence)
 {
-    return rgb_assign_sequence(id,existing_sequence);
+    return rgb_ctx_assign_sequence(ctx, id, existing_sequence);
 }
 
-
-int32_t rgb_led_register(pins_t red_pin, pins_t green_pin, pins_t blue_pin, led_t led_obj)
+int32_t rgb_ctx_led_register(rgb_ctx_t * ctx, pins_t red_pin, pins_t green_pin, pins_t blue_pin, led_t led_obj)
 {
     // Check there is enough led space to register rgb led
-    if((LEDS_MAX-led_get_count()) < 3)
+    if((LEDS_MAX-led_ctx_get_count(ctx->led)) < 3)
     {
         return -1;
     }
     // Register LEDS with led Module 
     // R
     led_obj.pinout = red_pin;
-    rgbLeds[rgb_led_count].led_id_red = led_register(led_obj);
+    ctx->leds[ctx->led_count].led_id_red = led_ctx_register(ctx->led, led_obj);
     // G
     led_obj.pinout = green_pin;
-    rgbLeds[rgb_led_count].led_id_green = led_register(led_obj);
+    ctx->leds[ctx->led_count].led_id_green = led_ctx_register(ctx->led, led_obj);
     // B
     led_obj.pinout = blue_pin;
-    rgbLeds[rgb_led_count].led_id_blue = led_register(led_obj);
+    ctx->leds[ctx->led_count].led_id_blue = led_ctx_register(ctx->led, led_obj);
 
-    return rgb_led_count++;
+    return ctx->led_count++;
 }
 
-void rgb_sequence_get_ids_from_id(int32_t rgbSequenceId, int32_t * redSequenceId, int32_t * greenSequenceId, int32_t * blueSequenceId)
+void rgb_ctx_sequence_get_ids_from_id(rgb_ctx_t * ctx, int32_t rgbSequenceId, int32_t * redSequenceId, int32_t * greenSequenceId, int32_t * blueSequenceId)
 {
-    *redSequenceId   = rgbSequences[rgbSequenceId].seq_id_red;
-    *greenSequenceId = rgbSequences[rgbSequenceId].seq_id_green;
-    *blueSequenceId  = rgbSequences[rgbSequenceId].seq_id_blue;
+    *redSequenceId   = ctx->sequences[rgbSequenceId].seq_id_red;
+    *greenSequenceId = ctx->sequences[rgbSequenceId].seq_id_green;
+    *blueSequenceId  = ctx->sequences[rgbSequenceId].seq_id_blue;
 }
 
-int32_t rgb_sequence_register(uint8_t length, uint16_t period, uint32_t * rgbSequence)
+int32_t rgb_ctx_sequence_register(rgb_ctx_t * ctx, uint8_t length, uint16_t period, uint32_t * rgbSequence)
 {
-    // Check there is enough space for RGB sequence 
-    if((MAX_SEQUENCES-sequence_get_count()) < 3)
+    // Turn RGB sequence into 3 seperate channels through byte manipulation 
+    sequence_t channels[3] = {0};
+
+    for(int _channel = 0; _channel < 3; _channel ++)
     {
-        return -1;
+        channels[_channel].length = length;
+        channels[_channel].period = period;
     }
-    
-    // Turn RGB sequence into 3 seperate channels through byte manipulation 
-    sequence_t sequenceTemp = {
-        .length = length,
-        .period = period,
-        };
-
-    // Creating colour channels 
-    uint8_t redSequence[MAX_SEQUENCE] = {0};
-    uint8_t grnSequence[MAX_SEQUENCE] = {0};
-    uint8_t bluSequence[MAX_SEQUENCE] = {0};
+
     // Adding in Colours 
-    for(int _iter = 0; _iter <length; _iter ++)
+    for(int _iter = 0; _iter < length && _iter < MAX_SEQUENCE; _iter ++)
+    {
+        channels[0].sequence[_iter] = (rgbSequence[_iter] >> 16) & 0xFF;
+        channels[1].sequence[_iter] = (rgbSequence[_iter] >> 8) & 0xFF;
+        channels[2].sequence[_iter] = rgbSequence[_iter] & 0xFF;
+    }
+
+    // Channels already in the table are shared, only the new ones need space
+    int32_t seqIds[3];
+    uint32_t newChannels = 0;
+    for(int _channel = 0; _channel < 3; _channel ++)
     {
-        redSequence[_iter] = (rgbSequence[_iter] >> 16) & 0xFF;
-        grnSequence[_iter] = (rgbSequence[_iter] >> 8) & 0xFF;
-        bluSequence[_iter] = rgbSequence[_iter] & 0xFF;
+        seqIds[_channel] = sequence_ctx_find(ctx->led->sequences, &channels[_channel]);
+        newChannels += seqIds[_channel] == -1;
+    }
+
+    // An RGB sequence with the same channels is the same sequence
+    int32_t existing = -1;
+    for(uint32_t _iter = 0; newChannels == 0 && _iter < ctx->seq_count; _iter ++)
+    {
+        rgb_sequence_t * rgbSeq = &ctx->sequences[_iter];
+        if(rgbSeq->seq_id_red == seqIds[0] && rgbSeq->seq_id_green == seqIds[1] && rgbSeq->seq_id_blue == seqIds[2])
+        {
+            existing = _iter;
+            break;
+        }
+    }
+
+    // Check there is enough space for RGB sequence 
+    if((MAX_SEQUENCES-sequence_ctx_get_count(ctx->led->sequences)) < newChannels ||
+        (existing == -1 && ctx->seq_count >= MAX_SEQUENCES))
+    {
+        return -1;
     }
     
-    // Register 3 Patterns 
-    memcpy(sequenceTemp.sequence, redSequence, length);
-    rgbSequences[rgb_seq_count].seq_id_red   = sequence_register(sequenceTemp);
-    memcpy(sequenceTemp.sequence, grnSequence, length);
-    rgbSequences[rgb_seq_count].seq_id_green = sequence_register(sequenceTemp);
-    memcpy(sequenceTemp.sequence, bluSequence, length);
-    rgbSequences[rgb_seq_count].seq_id_blue  = sequence_register(sequenceTemp);
+    // Register 3 Patterns, this counts a reference to each even if they already existed
+    int32_t rgbId = existing != -1 ? existing : (int32_t)ctx->seq_count ++;
+    rgb_sequence_t * rgbSeq = &ctx->sequences[rgbId];
+    rgbSeq->seq_id_red   = sequence_ctx_register(ctx->led->sequences, channels[0]);
+    rgbSeq->seq_id_green = sequence_ctx_register(ctx->led->sequences, channels[1]);
+    rgbSeq->seq_id_blue  = sequence_ctx_register(ctx->led->sequences, channels[2]);
     // Return the rgb sequence ID 
-    return rgb_seq_count ++;
+    return rgbId;
 }
 
-uint32_t rgb_sequence_get_count()
+uint32_t rgb_ctx_sequence_get_count(rgb_ctx_t * ctx)
 {
-    return rgb_seq_count;
+    return ctx->seq_count;
 }
 
-
-led_status_t rgb_assign_sequence(int32_t rgb_led_id, int32_t rgb_sequence_id)
+led_status_t rgb_ctx_assign_sequence(rgb_ctx_t * ctx, int32_t rgb_led_id, int32_t rgb_sequence_id)
 {
     // Check sequence exists 
-    if(!rgb_sequence_exists(rgb_sequence_id))
+    if(!rgb_ctx_sequence_exists(ctx, rgb_sequence_id))
     {
         return LED_ERR; 
     }
 
     // Check led exists 
-    if(!rgb_led_exists(rgb_led_id))
+    if(!rgb_ctx_led_exists(ctx, rgb_led_id))
     {
         return LED_ERR; 
     }
 
-    led_status_t redStatus   = led_assign_sequence(rgbLeds[rgb_led_id].led_id_red, rgbSequences[rgb_sequence_id].seq_id_red);
-    led_status_t blueStatus  = led_assign_sequence(rgbLeds[rgb_led_id].led_id_green, rgbSequences[rgb_sequence_id].seq_id_green);
-    led_status_t greenStatus = led_assign_sequence(rgbLeds[rgb_led_id].led_id_blue, rgbSequences[rgb_sequence_id].seq_id_blue);
+    rgb_led_t * rgbLed = &ctx->leds[rgb_led_id];
+    rgb_sequence_t * rgbSeq = &ctx->sequences[rgb_sequence_id];
+
+    led_status_t redStatus   = led_ctx_assign_sequence(ctx->led, rgbLed->led_id_red, rgbSeq->seq_id_red);
+    led_status_t blueStatus  = led_ctx_assign_sequence(ctx->led, rgbLed->led_id_green, rgbSeq->seq_id_green);
+    led_status_t greenStatus = led_ctx_assign_sequence(ctx->led, rgbLed->led_id_blue, rgbSeq->seq_id_blue);
 
     // Check status variables 
     if(!redStatus && !blueStatus && !greenStatus)
@@ -146,19 +169,103 @@ led_status_t rgb_assign_sequence(int32_t rgb_led_id, int32_t rgb_sequence_id)
     return LED_ERR;
 }
 
+void rgb_ctx_led_get_ids_from_id(rgb_ctx_t * ctx, int32_t rgbLedId, int32_t * redLedId, int32_t * greenLedId, int32_t * blueLedId)
+{
+    *redLedId   = ctx->leds[rgbLedId].led_id_red;
+    *greenLedId = ctx->leds[rgbLedId].led_id_green;
+    *blueLedId  = ctx->leds[rgbLedId].led_id_blue;
+}
+
+bool rgb_ctx_sequence_exists(rgb_ctx_t * ctx, int32_t rgb_sequence_id)
+{
+    return rgb_sequence_id < ctx->seq_count;
+}
+
+bool rgb_ctx_led_exists(rgb_ctx_t * ctx, int32_t rgb_led_id)
+{
+    return rgb_led_id < ctx->led_count;
+}
+
+led_status_t rgb_ctx_scene_entries(rgb_ctx_t * ctx, int32_t rgb_led_id, int32_t rgb_sequence_id, uint8_t sequence_idx, bool enabled, scene_entry_t * entries)
+{
+    if(!rgb_ctx_led_exists(ctx, rgb_led_id) || !rgb_ctx_sequence_exists(ctx, rgb_sequence_id))
+    {
+        return LED_ERR;
+    }
+
+    int32_t ledIds[3];
+    int32_t seqIds[3];
+    rgb_ctx_led_get_ids_from_id(ctx, rgb_led_id, &ledIds[0], &ledIds[1], &ledIds[2]);
+    rgb_ctx_sequence_get_ids_from_id(ctx, rgb_sequence_id, &seqIds[0], &seqIds[1], &seqIds[2]);
+
+    // One entry per colour channel
+    for(int _iter = 0; _iter < 3; _iter ++)
+    {
+        entries[_iter].led_id = ledIds[_iter];
+        entries[_iter].sequence_id = seqIds[_iter];
+        entries[_iter].sequence_idx = sequence_idx;
+        entries[_iter].enabled = enabled;
+    }
+
+    return LED_OK;
+}
+
+void rgb_led_init()
+{
+    rgb_ctx_init(&rgb_default_ctx, led_get_default_ctx());
+}
+
+uint32_t rgb_led_get_count()
+{
+    return rgb_ctx_led_get_count(&rgb_default_ctx);
+}
+
+led_status_t rgb_led_on(int32_t id, rgb_state_t existing_sequence)
+{
+    return rgb_ctx_led_on(&rgb_default_ctx, id, existing_sequence);
+}
+
+int32_t rgb_led_register(pins_t red_pin, pins_t green_pin, pins_t blue_pin, led_t led_obj)
+{
+    return rgb_ctx_led_register(&rgb_default_ctx, red_pin, green_pin, blue_pin, led_obj);
+}
+
+void rgb_sequence_get_ids_from_id(int32_t rgbSequenceId, int32_t * redSequenceId, int32_t * greenSequenceId, int32_t * blueSequenceId)
+{
+    rgb_ctx_sequence_get_ids_from_id(&rgb_default_ctx, rgbSequenceId, redSequenceId, greenSequenceId, blueSequenceId);
+}
+
+int32_t rgb_sequence_register(uint8_t length, uint16_t period, uint32_t * rgbSequence)
+{
+    return rgb_ctx_sequence_register(&rgb_default_ctx, length, period, rgbSequence);
+}
+
+uint32_t rgb_sequence_get_count()
+{
+    return rgb_ctx_sequence_get_count(&rgb_default_ctx);
+}
+
+led_status_t rgb_assign_sequence(int32_t rgb_led_id, int32_t rgb_sequence_id)
+{
+    return rgb_ctx_assign_sequence(&rgb_default_ctx, rgb_led_id, rgb_sequence_id);
+}
+
 void rgb_led_get_ids_from_id(int32_t rgbLedId, int32_t * redLedId, int32_t * greenLedId, int32_t * blueLedId)
 {
-    *redLedId   = rgbLeds[rgbLedId].led_id_red;
-    *greenLedId = rgbLeds[rgbLedId].led_id_green;
-    *blueLedId  = rgbLeds[rgbLedId].led_id_blue;
+    rgb_ctx_led_get_ids_from_id(&rgb_default_ctx, rgbLedId, redLedId, greenLedId, blueLedId);
 }
 
 bool rgb_sequence_exists(int32_t rgb_sequence_id)
 {
-    return rgb_sequence_id < rgb_seq_count;
+    return rgb_ctx_sequence_exists(&rgb_default_ctx, rgb_sequence_id);
 }
 
 bool rgb_led_exists(int32_t rgb_led_id)
 {
-    return rgb_led_id < rgb_led_count;
+    return rgb_ctx_led_exists(&rgb_default_ctx, rgb_led_id);
+}
+
+led_status_t rgb_scene_entries(int32_t rgb_led_id, int32_t rgb_sequence_id, uint8_t sequence_idx, bool enabled, scene_entry_t * entries)
+{
+    return rgb_ctx_scene_entries(&rgb_default_ctx, rgb_led_id, rgb_sequence_id, sequence_idx, enabled, entries);
 }
@@ -0,0 +1,147 @@
+#include "scene.h"
+#include <stddef.h>
+
+// The context used by the functions without a context.
+static scene_ctx_t scene_default_ctx = {0};
+
+scene_ctx_t * scene_get_default_ctx()
+{
+    return &scene_default_ctx;
+}
+
+void scene_ctx_init(scene_ctx_t * ctx, led_ctx_t * led_ctx)
+{
+    for (int i = 0; i < MAX_SCENES; i++)
+    {
+        ctx->scenes[i].entries = NULL;
+        ctx->scenes[i].length = 0;
+    }
+
+    ctx->count = 0;
+    ctx->active = -1;
+    ctx->stale_count = 0;
+    ctx->led = led_ctx;
+    __atomic_store_n(&ctx->pending, NULL, __ATOMIC_RELAXED);
+
+    led_ctx->scenes = ctx;
+}
+
+int32_t scene_ctx_register(scene_ctx_t * ctx, const scene_entry_t * entries, uint32_t length)
+{
+    if (ctx->count >= MAX_SCENES || (entries == NULL && length > 0))
+    {
+        return -1;
+    }
+
+    // Check the whole table up front so applying it in the update can't fail half way
+    for (uint32_t i = 0; i < length; i++)
+    {
+        if (!led_ctx_exists(ctx->led, entries[i].led_id) || !sequence_ctx_exists(ctx->led->sequences, entries[i].sequence_id))
+        {
+            return -1;
+        }
+    }
+
+    ctx->scenes[ctx->count].entries = entries;
+    ctx->scenes[ctx->count].length = length;
+
+    return ctx->count++;
+}
+
+uint32_t scene_ctx_get_count(scene_ctx_t * ctx)
+{
+    return ctx->count;
+}
+
+led_status_t scene_ctx_activate(scene_ctx_t * ctx, int32_t scene_id)
+{
+    if (scene_id < 0 || (uint32_t)scene_id >= ctx->count)
+    {
+        return LED_ERR;
+    }
+
+    __atomic_store_n(&ctx->pending, &ctx->scenes[scene_id], __ATOMIC_RELEASE);
+
+    return LED_OK;
+}
+
+int32_t scene_ctx_get_active(scene_ctx_t * ctx)
+{
+    return ctx->active;
+}
+
+uint32_t scene_ctx_get_stale_count(scene_ctx_t * ctx)
+{
+    return ctx->stale_count;
+}
+
+void scene_ctx_service(scene_ctx_t * ctx)
+{
+    scene_t * scene = __atomic_exchange_n(&ctx->pending, NULL, __ATOMIC_ACQUIRE);
+
+    if (scene == NULL)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < scene->length; i++)
+    {
+        const scene_entry_t * entry = &scene->entries[i];
+
+        // Checked at registration, but the LED or sequence may have been unregistered since
+        if (!led_ctx_exists(ctx->led, entry->led_id) || !sequence_ctx_exists(ctx->led->sequences, entry->sequence_id))
+        {
+            ctx->stale_count++;
+            continue;
+        }
+
+        led_ctx_assign_sequence(ctx->led, entry->led_id, entry->sequence_id);
+        led_ctx_offset_sequence(ctx->led, entry->led_id, entry->sequence_idx);
+
+        if (entry->enabled)
+        {
+            led_ctx_enable(ctx->led, entry->led_id);
+        }
+        else
+        {
+            led_ctx_disable(ctx->led, entry->led_id);
+        }
+    }
+
+    ctx->active = scene - ctx->scenes;
+}
+
+void scene_init()
+{
+    scene_ctx_init(&scene_default_ctx, led_get_default_ctx());
+}
+
+int32_t scene_register(const scene_entry_t * entries, uint32_t length)
+{
+    return scene_ctx_register(&scene_default_ctx, entries, length);
+}
+
+uint32_t scene_get_count()
+{
+    return scene_ctx_get_count(&scene_default_ctx);
+}
+
+led_status_t scene_activate(int32_t scene_id)
+{
+    return scene_ctx_activate(&scene_default_ctx, scene_id);
+}
+
+int32_t scene_get_active()
+{
+    return scene_ctx_get_active(&scene_default_ctx);
+}
+
+uint32_t scene_get_stale_count()
+{
+    return scene_ctx_get_stale_count(&scene_default_ctx);
+}
+
+void scene_service()
+{
+    scene_ctx_service(&scene_default_ctx);
+}
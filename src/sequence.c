@@ -2,56 +2,485 @@
 #include <string.h>
 #include <stdio.h>
 
-//sequence_t sequence = {0};
-sequence_t sequences[MAX_SEQUENCES] = {0};
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
 
-static uint32_t count = 0;
+// The table used by the functions without a context.
+static sequence_ctx_t sequence_default_ctx = {0};
 
-void sequence_init()
+sequence_ctx_t * sequence_get_default_ctx()
+{
+    return &sequence_default_ctx;
+}
+
+/**
+ * @brief Finds the slot of a registered sequence's ID.
+ *
+ * @return int32_t - the slot, -1 if the ID is out of range, unregistered or from an older generation.
+ */
+static int32_t sequence_slot(const sequence_ctx_t * ctx, uint32_t sequence_id)
+{
+    uint32_t slot = HANDLE_SLOT(sequence_id);
+
+    if (slot >= ctx->count || ctx->refs[slot] == 0 || ctx->generations[slot] != HANDLE_GENERATION(sequence_id))
+    {
+        return -1;
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Stores a new sequence in a free slot, without looking for an existing copy.
+ *
+ * @param unique - true if sequence_ctx_find() should never return it.
+ * @return int32_t - the ID of the sequence, -1 if the table is full.
+ */
+static int32_t sequence_store(sequence_ctx_t * ctx, sequence_t sequence, bool unique);
+
+/**
+ * @brief Moves the retired buffers back to the free ones if no update is reading the table. Any update 
+ * that starts afterwards can only see the versions published since.
+ */
+static void buffer_reclaim(sequence_ctx_t * ctx)
+{
+    // Versions unpublished by commits since the last call are retired like any other
+    for (uint32_t slot = 0; slot < ctx->count; slot++)
+    {
+        uint8_t replaced = __atomic_exchange_n(&ctx->replaced[slot], SEQUENCE_NO_BUFFER, __ATOMIC_ACQUIRE);
+
+        if (replaced != SEQUENCE_NO_BUFFER)
+        {
+            ctx->retired_buffers[ctx->retired_count++] = replaced;
+        }
+    }
+
+    if (ctx->retired_count == 0 || __atomic_load_n(&ctx->readers, __ATOMIC_SEQ_CST) != 0)
+    {
+        return;
+    }
+
+    while (ctx->retired_count > 0)
+    {
+        ctx->free_buffers[ctx->free_buffer_count++] = ctx->retired_buffers[--ctx->retired_count];
+    }
+}
+
+/**
+ * @brief Takes a buffer for a new version of a sequence.
+ *
+ * @return sequence_t * - the buffer, NULL if every spare buffer is still retired.
+ */
+static sequence_t * buffer_take(sequence_ctx_t * ctx)
+{
+    buffer_reclaim(ctx);
+
+    if (ctx->free_buffer_count > 0)
+    {
+        return &ctx->buffers[ctx->free_buffers[--ctx->free_buffer_count]];
+    }
+
+    if (ctx->buffers_used < SEQUENCE_BUFFERS)
+    {
+        return &ctx->buffers[ctx->buffers_used++];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Hands back the buffer of a version that is no longer published, it's reused once no update 
+ * can still be reading it.
+ */
+static void buffer_retire(sequence_ctx_t * ctx, sequence_t * buffer)
+{
+    ctx->retired_buffers[ctx->retired_count++] = buffer - ctx->buffers;
+    buffer_reclaim(ctx);
+}
+
+/**
+ * @brief Publishes a version of a sequence, updates reading the slot from now on see it.
+ */
+static void buffer_publish(sequence_ctx_t * ctx, uint32_t slot, sequence_t * buffer)
+{
+    __atomic_store_n(&ctx->current[slot], buffer, __ATOMIC_RELEASE);
+}
+
+void sequence_ctx_init(sequence_ctx_t * ctx)
 {
     for (int i = 0; i < MAX_SEQUENCES; i++)
     {
-        memset(&(sequences[i]), 0, sizeof(sequence_t));
+        ctx->current[i] = NULL;
+        ctx->hashes[i] = 0;
+        ctx->refs[i] = 0;
+        ctx->unique[i] = false;
+        ctx->pinned[i] = false;
+        ctx->generations[i] = 0;
+        ctx->staged[i] = SEQUENCE_NO_BUFFER;
+        ctx->replaced[i] = SEQUENCE_NO_BUFFER;
     }
 
-    count = 0;
+    memset(ctx->buffers, 0, sizeof(ctx->buffers));
+    ctx->free_buffer_count = 0;
+    ctx->buffers_used = 0;
+    ctx->retired_count = 0;
+    ctx->readers = 0;
+    ctx->free_count = 0;
+    ctx->count = 0;
     return;
 }
 
-uint32_t sequence_get_count()
+void sequence_ctx_read_begin(sequence_ctx_t * ctx)
 {
-    return count;
+    __atomic_fetch_add(&ctx->readers, 1, __ATOMIC_SEQ_CST);
 }
 
-int32_t sequence_register(sequence_t _sequence)
+void sequence_ctx_read_end(sequence_ctx_t * ctx)
+{
+    __atomic_fetch_sub(&ctx->readers, 1, __ATOMIC_SEQ_CST);
+}
+
+uint32_t sequence_ctx_get_count(const sequence_ctx_t * ctx)
+{
+    return ctx->count - ctx->free_count;
+}
+
+uint32_t sequence_hash(const sequence_t * sequence)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    uint32_t length = sequence->length < MAX_SEQUENCE ? sequence->length : MAX_SEQUENCE;
+
+    hash = (hash ^ sequence->length) * FNV_PRIME;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        hash = (hash ^ ((sequence->period >> shift) & 0xFF)) * FNV_PRIME;
+    }
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ sequence->sequence[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+int32_t sequence_ctx_find(const sequence_ctx_t * ctx, const sequence_t * sequence)
+{
+    uint32_t hash = sequence_hash(sequence);
+    uint32_t length = sequence->length < MAX_SEQUENCE ? sequence->length : MAX_SEQUENCE;
+
+    for (uint32_t i = 0; i < ctx->count; i++)
+    {
+        const sequence_t * existing = ctx->current[i];
+
+        // The hash rules out almost every sequence, the content is only compared when it matches
+        if (ctx->refs[i] > 0 && !ctx->unique[i] && ctx->hashes[i] == hash && existing->length == sequence->length && existing->period == sequence->period &&
+            memcmp(existing->sequence, sequence->sequence, length) == 0)
+        {
+            return HANDLE_MAKE(i, ctx->generations[i]);
+        }
+    }
+
+    return -1;
+}
+
+int32_t sequence_ctx_register(sequence_ctx_t * ctx, sequence_t _sequence)
 {
-    if (count >= MAX_SEQUENCES)
+    int32_t existing = sequence_ctx_find(ctx, &_sequence);
+
+    if (existing != -1)
+    {
+        uint32_t slot = HANDLE_SLOT(existing);
+        if (ctx->refs[slot] < UINT16_MAX)
+        {
+            ctx->refs[slot]++;
+        }
+        return existing;
+    }
+
+    return sequence_store(ctx, _sequence, false);
+}
+
+int32_t sequence_ctx_register_unique(sequence_ctx_t * ctx, sequence_t _sequence)
+{
+    return sequence_store(ctx, _sequence, true);
+}
+
+static int32_t sequence_store(sequence_ctx_t * ctx, sequence_t _sequence, bool unique)
+{
+    if (ctx->free_count == 0 && ctx->count >= MAX_SEQUENCES)
+    {
+        return -1;
+    }
+
+    sequence_t * buffer = buffer_take(ctx);
+
+    if (buffer == NULL)
     {
         return -1;
     }
 
-    sequences[count] = _sequence;
+    uint32_t slot;
+
+    if (ctx->free_count > 0)
+    {
+        // Reuse the most recently freed slot
+        slot = ctx->free_head;
+        ctx->free_head = ctx->free_next[slot];
+        ctx->free_count--;
+    }
+    else
+    {
+        slot = ctx->count++;
+    }
+
+    *buffer = _sequence;
+    buffer_publish(ctx, slot, buffer);
+    ctx->hashes[slot] = sequence_hash(&_sequence);
+    ctx->refs[slot] = 1;
+    ctx->unique[slot] = unique;
+    ctx->pinned[slot] = false;
 
-    // we increment in the return statement because we want to return the value of count BEFORE incrementing
-    // as this is the actual id of the sequence
-    return count++;
+    return HANDLE_MAKE(slot, ctx->generations[slot]);
 }
 
-bool sequence_exists(uint32_t sequence_id)
+sequence_status_t sequence_ctx_unregister(sequence_ctx_t * ctx, int32_t sequence_id)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    if (slot == -1 || (ctx->pinned[slot] && ctx->refs[slot] == 1))
+    {
+        return SEQUENCE_ERROR;
+    }
+
+    // A saturated count no longer knows how many registrations are left, so the sequence stays
+    if (ctx->refs[slot] == UINT16_MAX)
+    {
+        return SEQUENCE_OK;
+    }
+
+    // Interned sequences stay until every registration is dropped
+    if (--ctx->refs[slot] > 0)
+    {
+        return SEQUENCE_OK;
+    }
+
+    sequence_ctx_discard(ctx, sequence_id);
+    ctx->generations[slot] = HANDLE_NEXT_GENERATION(ctx->generations[slot]);
+    sequence_t * old = ctx->current[slot];
+    buffer_publish(ctx, slot, NULL);
+    buffer_retire(ctx, old);
+    ctx->free_next[slot] = ctx->free_head;
+    ctx->free_head = slot;
+    ctx->free_count++;
+
+    return SEQUENCE_OK;
+}
+
+sequence_status_t sequence_ctx_pin(sequence_ctx_t * ctx, int32_t sequence_id)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    if (slot == -1)
+    {
+        return SEQUENCE_ERROR;
+    }
+
+    ctx->pinned[slot] = true;
+
+    return SEQUENCE_OK;
+}
+
+sequence_status_t sequence_ctx_update(sequence_ctx_t * ctx, int32_t sequence_id, sequence_t _sequence)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    // A staged version would overwrite this one when it's committed
+    if (slot == -1 || __atomic_load_n(&ctx->staged[slot], __ATOMIC_ACQUIRE) != SEQUENCE_NO_BUFFER)
+    {
+        return SEQUENCE_ERROR;
+    }
+
+    sequence_t * buffer = buffer_take(ctx);
+
+    if (buffer == NULL)
+    {
+        return SEQUENCE_ERROR;
+    }
+
+    // Built in full before it's published, nothing reads this buffer yet
+    *buffer = _sequence;
+
+    sequence_t * old = ctx->current[slot];
+    buffer_publish(ctx, slot, buffer);
+    ctx->hashes[slot] = sequence_hash(&_sequence);
+    buffer_retire(ctx, old);
+
+    return SEQUENCE_OK;
+}
+
+sequence_status_t sequence_ctx_stage(sequence_ctx_t * ctx, int32_t sequence_id, sequence_t _sequence)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    if (slot == -1 || __atomic_load_n(&ctx->staged[slot], __ATOMIC_ACQUIRE) != SEQUENCE_NO_BUFFER)
+    {
+        return SEQUENCE_ERROR;
+    }
+
+    sequence_t * buffer = buffer_take(ctx);
+
+    if (buffer == NULL)
+    {
+        return SEQUENCE_ERROR;
+    }
+
+    *buffer = _sequence;
+    __atomic_store_n(&ctx->staged[slot], (uint8_t)(buffer - ctx->buffers), __ATOMIC_RELEASE);
+
+    return SEQUENCE_OK;
+}
+
+const sequence_t * sequence_ctx_get_staged(const sequence_ctx_t * ctx, int32_t sequence_id)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    if (slot == -1)
+    {
+        return NULL;
+    }
+
+    uint8_t staged = __atomic_load_n(&ctx->staged[slot], __ATOMIC_ACQUIRE);
+
+    return staged == SEQUENCE_NO_BUFFER ? NULL : &ctx->buffers[staged];
+}
+
+bool sequence_ctx_commit(sequence_ctx_t * ctx, int32_t sequence_id)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    if (slot == -1)
+    {
+        return false;
+    }
+
+    uint8_t staged = __atomic_exchange_n(&ctx->staged[slot], SEQUENCE_NO_BUFFER, __ATOMIC_ACQ_REL);
+
+    if (staged == SEQUENCE_NO_BUFFER)
+    {
+        return false;
+    }
+
+    // The buffer pool isn't touched here, the old version is handed to the next buffer_reclaim()
+    sequence_t * old = ctx->current[slot];
+    buffer_publish(ctx, slot, &ctx->buffers[staged]);
+    ctx->hashes[slot] = sequence_hash(&ctx->buffers[staged]);
+    __atomic_store_n(&ctx->replaced[slot], (uint8_t)(old - ctx->buffers), __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void sequence_ctx_discard(sequence_ctx_t * ctx, int32_t sequence_id)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    if (slot == -1)
+    {
+        return;
+    }
+
+    uint8_t staged = __atomic_exchange_n(&ctx->staged[slot], SEQUENCE_NO_BUFFER, __ATOMIC_ACQ_REL);
+
+    if (staged != SEQUENCE_NO_BUFFER)
+    {
+        buffer_retire(ctx, &ctx->buffers[staged]);
+    }
+}
+
+uint32_t sequence_ctx_get_refs(const sequence_ctx_t * ctx, uint32_t sequence_id)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    if (slot == -1)
+    {
+        return 0;
+    }
+
+    return ctx->refs[slot];
+}
+
+bool sequence_ctx_exists(const sequence_ctx_t * ctx, uint32_t sequence_id)
 {
-    if(sequence_id < count)
+    if(sequence_slot(ctx, sequence_id) != -1)
     {
         return true;
     }
     return false; 
 }
 
- sequence_t * sequence_get_from_id(uint32_t sequence_id)
- {
-    if (!sequence_exists(sequence_id))
+sequence_t * sequence_ctx_get_from_id(sequence_ctx_t * ctx, uint32_t sequence_id)
+{
+    int32_t slot = sequence_slot(ctx, sequence_id);
+
+    if (slot == -1)
     {
         return NULL;
     }
     
-    return &(sequences[sequence_id]);
- }
\ No newline at end of file
+    return __atomic_load_n(&ctx->current[slot], __ATOMIC_ACQUIRE);
+}
+
+void sequence_init()
+{
+    sequence_ctx_init(&sequence_default_ctx);
+}
+
+uint32_t sequence_get_count()
+{
+    return sequence_ctx_get_count(&sequence_default_ctx);
+}
+
+int32_t sequence_register(sequence_t _sequence)
+{
+    return sequence_ctx_register(&sequence_default_ctx, _sequence);
+}
+
+sequence_status_t sequence_update(int32_t sequence_id, sequence_t _sequence)
+{
+    return sequence_ctx_update(&sequence_default_ctx, sequence_id, _sequence);
+}
+
+int32_t sequence_register_unique(sequence_t _sequence)
+{
+    return sequence_ctx_register_unique(&sequence_default_ctx, _sequence);
+}
+
+sequence_status_t sequence_unregister(int32_t sequence_id)
+{
+    return sequence_ctx_unregister(&sequence_default_ctx, sequence_id);
+}
+
+sequence_status_t sequence_pin(int32_t sequence_id)
+{
+    return sequence_ctx_pin(&sequence_default_ctx, sequence_id);
+}
+
+int32_t sequence_find(const sequence_t * sequence)
+{
+    return sequence_ctx_find(&sequence_default_ctx, sequence);
+}
+
+uint32_t sequence_get_refs(uint32_t sequence_id)
+{
+    return sequence_ctx_get_refs(&sequence_default_ctx, sequence_id);
+}
+
+bool sequence_exists(uint32_t sequence_id)
+{
+    return sequence_ctx_exists(&sequence_default_ctx, sequence_id);
+}
+
+ sequence_t * sequence_get_from_id(uint32_t sequence_id)
+ {
+    return sequence_ctx_get_from_id(&sequence_default_ctx, sequence_id);
+ }
@@ -0,0 +1,221 @@
+/**
+ * @file bench.c
+ * @brief Measures the cost of led_ctx_update_state() across LED counts, sequence lengths, single and
+ * RGB LEDs and mixes of static and animated LEDs. Prints one CSV row per scenario so runs from
+ * different releases can be compared by a script.
+ *
+ * Usage: bench [scale], scale multiplies the number of ticks run for each scenario (default 1).
+ */
+
+#include "led.h"
+#include "rgb_led.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Updates per scenario are roughly this many LED updates divided by the LED count. */
+#define BENCH_LED_TICKS 1000000
+
+/** Fewest updates run for a scenario. */
+#define BENCH_MIN_TICKS 100
+
+static sequence_ctx_t sequences;
+static led_ctx_t ctx;
+static rgb_ctx_t rgb;
+
+static uint64_t write_calls = 0;
+
+/**
+ * @brief The kind of LEDs a scenario registers.
+ */
+typedef enum{
+    BENCH_SINGLE,
+    BENCH_RGB
+}bench_kind_t;
+
+/**
+ * @brief Which share of the LEDs are animated, the rest are turned on.
+ */
+typedef enum{
+    BENCH_ANIMATED,
+    BENCH_MOSTLY_ANIMATED,
+    BENCH_MOSTLY_STATIC
+}bench_mix_t;
+
+static const char * kind_names[] = {"single", "rgb"};
+static const char * mix_names[] = {"animated", "mostly_animated", "mostly_static"};
+
+static void bench_write(pins_t pins, led_state_t state)
+{
+    (void)pins;
+    (void)state;
+    write_calls++;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/** Fewest LEDs, or RGB LEDs, a scenario mixing static and animated LEDs needs to have its share. */
+#define BENCH_MIX_MIN 10
+
+/**
+ * @brief Decides if the nth LED of a scenario is animated. One in every ten is the odd one out, the
+ * last of each ten so a scenario with fewer LEDs doesn't start with it.
+ */
+static bool is_animated(uint32_t n, bench_mix_t mix)
+{
+    switch (mix)
+    {
+        case BENCH_MOSTLY_ANIMATED:
+            return n % 10 != 9;
+        case BENCH_MOSTLY_STATIC:
+            return n % 10 == 9;
+        default:
+            return true;
+    }
+}
+
+/**
+ * @brief Registers the LEDs of a scenario in a freshly initialised context.
+ *
+ * @return uint32_t - the number of single LEDs registered.
+ */
+static uint32_t build_scenario(uint32_t leds, uint8_t length, bench_kind_t kind, bench_mix_t mix)
+{
+    led_ctx_init(&ctx, &sequences, 1);
+    led_ctx_set_write(&ctx, bench_write);
+    rgb_ctx_init(&rgb, &ctx);
+
+    led_t led = {.enabled = true, .pinout = {.pin = 0}, .sequence_id = -1};
+
+    if (kind == BENCH_SINGLE)
+    {
+        sequence_t sequence = {.length = length, .period = length * 10u};
+        for (uint32_t i = 0; i < length; i++)
+        {
+            sequence.sequence[i] = (i % 2) ? LED_ON : LED_OFF;
+        }
+        int32_t sequence_id = sequence_ctx_register(&sequences, sequence);
+
+        for (uint32_t n = 0; n < leds; n++)
+        {
+            led.pinout.pin = n;
+            int32_t led_id = led_ctx_register(&ctx, led);
+
+            if (is_animated(n, mix))
+            {
+                led_ctx_assign_sequence(&ctx, led_id, sequence_id);
+                // Spread the LEDs over the sequence so they don't all step on the same update
+                led_ctx_offset_sequence(&ctx, led_id, n % length);
+            }
+            else
+            {
+                led_ctx_turn_on(&ctx, led_id);
+            }
+        }
+
+        return leds;
+    }
+
+    uint32_t colours[MAX_SEQUENCE];
+    for (uint32_t i = 0; i < length; i++)
+    {
+        colours[i] = (i % 2) ? 0xFF8000 : 0x0080FF;
+    }
+    int32_t rgb_sequence_id = rgb_ctx_sequence_register(&rgb, length, length * 10u, colours);
+
+    for (uint32_t n = 0; n < leds / 3; n++)
+    {
+        pins_t pin = {.pin = n};
+        int32_t rgb_id = rgb_ctx_led_register(&rgb, pin, pin, pin, led);
+
+        rgb_ctx_assign_sequence(&rgb, rgb_id, is_animated(n, mix) ? rgb_sequence_id : RGB_WHITE);
+    }
+
+    return led_ctx_get_count(&ctx);
+}
+
+/**
+ * @brief Runs one scenario and prints its row.
+ */
+static void run_scenario(uint32_t leds, uint8_t length, bench_kind_t kind, bench_mix_t mix, uint32_t scale)
+{
+    uint32_t registered = build_scenario(leds, length, kind, mix);
+
+    if (registered == 0)
+    {
+        return;
+    }
+
+    uint32_t ticks = BENCH_LED_TICKS / registered;
+    if (ticks < BENCH_MIN_TICKS)
+    {
+        ticks = BENCH_MIN_TICKS;
+    }
+    ticks *= scale;
+
+    // Get the first writes of the static LEDs out of the way, they aren't the steady state
+    led_ctx_update_state(&ctx);
+    write_calls = 0;
+
+    uint64_t start = now_ns();
+    for (uint32_t t = 0; t < ticks; t++)
+    {
+        led_ctx_update_state(&ctx);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    printf("%s,%s,%u,%u,%u,%.3f,%.3f,%.2f\n",
+        kind_names[kind], mix_names[mix], (unsigned)registered, (unsigned)length, (unsigned)ticks,
+        (double)elapsed / ticks / 1000.0,
+        (double)elapsed / ((double)ticks * registered),
+        (double)write_calls / ticks);
+}
+
+int main(int argc, char ** argv)
+{
+    static const uint32_t led_counts[] = {1, 16, 64, 256, 1024, 4096, 16384};
+    static const uint8_t lengths[] = {2, 16, MAX_SEQUENCE};
+    uint32_t scale = argc > 1 ? (uint32_t)atoi(argv[1]) : 1;
+
+    if (scale == 0)
+    {
+        scale = 1;
+    }
+
+    printf("kind,mix,leds,sequence_length,ticks,us_per_tick,ns_per_led_tick,writes_per_tick\n");
+
+    for (uint32_t c = 0; c < sizeof(led_counts) / sizeof(led_counts[0]); c++)
+    {
+        if (led_counts[c] > LEDS_MAX)
+        {
+            break;
+        }
+
+        for (uint32_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+        {
+            for (int kind = BENCH_SINGLE; kind <= BENCH_RGB; kind++)
+            {
+                uint32_t units = kind == BENCH_RGB ? led_counts[c] / 3 : led_counts[c];
+
+                for (int mix = BENCH_ANIMATED; mix <= BENCH_MOSTLY_STATIC; mix++)
+                {
+                    // Too few LEDs for a mix to be what its name says
+                    if (mix != BENCH_ANIMATED && units < BENCH_MIX_MIN)
+                    {
+                        continue;
+                    }
+
+                    run_scenario(led_counts[c], lengths[l], kind, mix, scale);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef LED_USER_CONFIG_H
+#define LED_USER_CONFIG_H
+
+// Build options for the tests, found ahead of the project's own led_user_config.h. The optional
+// host-only modules are built so they are tested too.
+#define LED_OVERLAYS
+#define LED_TRACE
+#define LED_INSTRUMENTATION
+#define LED_BATCH
+#define LED_PARALLEL
+
+#endif
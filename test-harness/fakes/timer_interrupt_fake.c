@@ -1 +1,169 @@
-#include "timer_interrupt_fake.h"
\ No newline at end of file
+#include "timer_interrupt_fake.h"
+#include "../spies/led_spy.h"
+#include <stddef.h>
+#include <time.h>
+
+static led_ctx_t * fake_ctx = NULL;
+static uint32_t now_ms = 0;
+static uint32_t update_count = 0;
+static uint64_t engine_ns = 0;
+
+static write_log_t records;
+
+static led_state_t pin_states[TIMER_FAKE_PINS_MAX];
+static uint32_t change_counts[TIMER_FAKE_PINS_MAX];
+static uint32_t last_change_ms[TIMER_FAKE_PINS_MAX];
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void record_write(pins_t pins, led_state_t state)
+{
+    write_log_record(&records, now_ms, pins, state);
+
+    // The spy sees the writes too so they can be dumped to a VCD
+    led_spy_set_time(now_ms);
+    led_spy_set_state(pins.pin, state);
+
+    if (pins.pin >= TIMER_FAKE_PINS_MAX)
+    {
+        return;
+    }
+
+    if (pin_states[pins.pin] != state)
+    {
+        pin_states[pins.pin] = state;
+        change_counts[pins.pin]++;
+        last_change_ms[pins.pin] = now_ms;
+    }
+}
+
+static void update(uint32_t elapsed, bool tickless)
+{
+    uint64_t start = host_ns();
+
+    if (tickless)
+    {
+        led_ctx_update_elapsed(fake_ctx, elapsed);
+    }
+    else
+    {
+        led_ctx_update_state(fake_ctx);
+    }
+
+    engine_ns += host_ns() - start;
+    update_count++;
+}
+
+void timer_fake_init(led_ctx_t * ctx)
+{
+    fake_ctx = ctx;
+    now_ms = 0;
+    update_count = 0;
+    engine_ns = 0;
+    write_log_clear(&records);
+
+    for (int i = 0; i < TIMER_FAKE_PINS_MAX; i++)
+    {
+        pin_states[i] = LED_UNDEFINED;
+        change_counts[i] = 0;
+        last_change_ms[i] = 0;
+    }
+
+    led_ctx_set_write(ctx, record_write);
+}
+
+void timer_fake_run_for(uint32_t ms)
+{
+    uint32_t end = now_ms + ms;
+    uint32_t period = fake_ctx->timer_period;
+
+    while ((int32_t)(end - now_ms) >= (int32_t)period && period > 0)
+    {
+        now_ms += period;
+        update(period, false);
+    }
+}
+
+void timer_fake_run_tickless(uint32_t ms)
+{
+    uint32_t end = now_ms + ms;
+
+    for (;;)
+    {
+        uint32_t wait = led_ctx_get_next_wakeup(fake_ctx);
+
+        if (wait > end - now_ms)
+        {
+            // Nothing due before the end, the clock just moves on. Still an update, so it's counted and timed
+            if (end != now_ms)
+            {
+                update(end - now_ms, true);
+                now_ms = end;
+            }
+            return;
+        }
+
+        now_ms += wait;
+        update(wait, true);
+    }
+}
+
+uint32_t timer_fake_now(void)
+{
+    return now_ms;
+}
+
+uint32_t timer_fake_get_update_count(void)
+{
+    return update_count;
+}
+
+uint64_t timer_fake_get_engine_ns(void)
+{
+    return engine_ns;
+}
+
+uint32_t timer_fake_get_write_count(void)
+{
+    return records.count;
+}
+
+const write_log_entry_t * timer_fake_get_write(uint32_t n)
+{
+    return write_log_get(&records, n);
+}
+
+led_state_t timer_fake_get_state(uint32_t pin)
+{
+    if (pin >= TIMER_FAKE_PINS_MAX)
+    {
+        return LED_UNDEFINED;
+    }
+
+    return pin_states[pin];
+}
+
+uint32_t timer_fake_get_change_count(uint32_t pin)
+{
+    if (pin >= TIMER_FAKE_PINS_MAX)
+    {
+        return 0;
+    }
+
+    return change_counts[pin];
+}
+
+uint32_t timer_fake_get_last_change_ms(uint32_t pin)
+{
+    if (pin >= TIMER_FAKE_PINS_MAX)
+    {
+        return 0;
+    }
+
+    return last_change_ms[pin];
+}
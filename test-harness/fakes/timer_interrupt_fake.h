@@ -1 +1,52 @@
-// init function to set period
\ No newline at end of file
+#ifndef TIMER_INTERRUPT_FAKE_H
+#define TIMER_INTERRUPT_FAKE_H
+
+// Stands in for the hardware timer interrupt on the host. A virtual clock drives an LED context's
+// updates, as fast as the host can run them, and every write() the context makes is recorded with
+// the virtual time it was made at. The writes are passed on to the LED spy, with the time, so a run 
+// can be saved with led_spy_vcd_open().
+
+#include "../../inc/led.h"
+#include "../spies/write_log.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIMER_FAKE_RECORD_MAX WRITE_LOG_MAX
+
+#define TIMER_FAKE_PINS_MAX 64
+
+// the timer fires every timer_period the context was initialised with, the context's writes go to the
+// recorder from now on
+void timer_fake_init(led_ctx_t * ctx);
+
+// fires the timer interrupt every period until ms of virtual time have passed
+void timer_fake_run_for(uint32_t ms);
+
+// like timer_fake_run_for() but only wakes when led_ctx_get_next_wakeup() asks to, as a tickless build would
+void timer_fake_run_tickless(uint32_t ms);
+
+// virtual time since init in ms
+uint32_t timer_fake_now(void);
+
+// number of updates the fake has made
+uint32_t timer_fake_get_update_count(void);
+
+// host time spent inside the updates, in ns
+uint64_t timer_fake_get_engine_ns(void);
+
+// number of writes made, including ones past the end of the record
+uint32_t timer_fake_get_write_count(void);
+
+// the nth write made, only the first TIMER_FAKE_RECORD_MAX are kept. NULL if not kept.
+const write_log_entry_t * timer_fake_get_write(uint32_t n);
+
+// last state written to a pin
+led_state_t timer_fake_get_state(uint32_t pin);
+
+// number of writes to a pin that changed its state
+uint32_t timer_fake_get_change_count(uint32_t pin);
+
+// virtual time of the last write to a pin that changed its state
+uint32_t timer_fake_get_last_change_ms(uint32_t pin);
+
+#endif
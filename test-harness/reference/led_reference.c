@@ -0,0 +1,220 @@
+#include "led_reference.h"
+#include <stddef.h>
+
+static const sequence_t * reference_sequence(led_reference_t * ref, int32_t sequence_id)
+{
+    if (sequence_id < 0)
+    {
+        return NULL;
+    }
+
+    return sequence_ctx_get_from_id(ref->sequences, sequence_id);
+}
+
+static bool reference_exists(led_reference_t * ref, int32_t led_id)
+{
+    return led_id >= 0 && led_id < (int32_t)ref->count;
+}
+
+static bool reference_rule(led_reference_t * ref, led_reference_rule_t rule)
+{
+    return (ref->rules & rule) != 0;
+}
+
+void led_reference_init(led_reference_t * ref, sequence_ctx_t * sequences, uint32_t period_ms, uint32_t rules, led_write_fn_t write)
+{
+    ref->count = 0;
+    ref->timer_period = period_ms;
+    ref->rules = rules;
+    ref->sequences = sequences;
+    ref->write = write;
+}
+
+int32_t led_reference_register(led_reference_t * ref, led_t led)
+{
+    if (ref->count >= LEDS_MAX)
+    {
+        return -1;
+    }
+
+    led_reference_led_t * model = &ref->leds[ref->count];
+
+    model->pinout = led.pinout;
+    model->enabled = led.enabled;
+    model->sequence_id = led.sequence_id;
+    model->sequence_idx = led.sequence_idx;
+    model->timer_count = led.timer_count;
+    model->initialized = led.sequence_initialized;
+    model->pending = reference_sequence(ref, led.sequence_id) != NULL;
+    model->repeats_left = 0;
+    model->next_sequence = -1;
+    model->held = false;
+    model->playback_rate = LED_RATE_1X;
+    model->playback_fraction = 0;
+
+    return ref->count++;
+}
+
+led_status_t led_reference_assign_sequence(led_reference_t * ref, int32_t led_id, int32_t sequence_id)
+{
+    if (!reference_exists(ref, led_id) || reference_sequence(ref, sequence_id) == NULL)
+    {
+        return LED_ERR;
+    }
+
+    led_reference_led_t * model = &ref->leds[led_id];
+
+    model->sequence_id = sequence_id;
+    model->sequence_idx = 0;
+    model->timer_count = 0;
+    model->initialized = false;
+    model->pending = true;
+    model->repeats_left = 0;
+    model->next_sequence = -1;
+    model->held = false;
+
+    return LED_OK;
+}
+
+led_status_t led_reference_assign_sequence_repeat(led_reference_t * ref, int32_t led_id, int32_t sequence_id, uint16_t repeats, int32_t next_sequence_id)
+{
+    if (next_sequence_id != -1 && reference_sequence(ref, next_sequence_id) == NULL)
+    {
+        return LED_ERR;
+    }
+
+    if (led_reference_assign_sequence(ref, led_id, sequence_id) != LED_OK)
+    {
+        return LED_ERR;
+    }
+
+    if (!reference_rule(ref, LED_REFERENCE_REPEATS))
+    {
+        return LED_OK;
+    }
+
+    ref->leds[led_id].repeats_left = repeats;
+    ref->leds[led_id].next_sequence = repeats > 0 ? next_sequence_id : -1;
+
+    return LED_OK;
+}
+
+void led_reference_enable(led_reference_t * ref, int32_t led_id)
+{
+    if (reference_exists(ref, led_id))
+    {
+        // Enabling writes the state again even if it's static
+        ref->leds[led_id].enabled = true;
+        ref->leds[led_id].pending = true;
+    }
+}
+
+void led_reference_disable(led_reference_t * ref, int32_t led_id)
+{
+    if (reference_exists(ref, led_id))
+    {
+        ref->leds[led_id].enabled = false;
+    }
+}
+
+void led_reference_offset_sequence(led_reference_t * ref, int32_t led_id, uint8_t offset)
+{
+    if (reference_exists(ref, led_id))
+    {
+        ref->leds[led_id].sequence_idx = offset;
+        ref->leds[led_id].pending = true;
+    }
+}
+
+void led_reference_set_playback_rate(led_reference_t * ref, int32_t led_id, uint16_t rate)
+{
+    if (reference_exists(ref, led_id))
+    {
+        ref->leds[led_id].playback_rate = rate;
+    }
+}
+
+void led_reference_update_state(led_reference_t * ref)
+{
+    for (uint32_t i = 0; i < ref->count; i++)
+    {
+        led_reference_led_t * model = &ref->leds[i];
+        const sequence_t * sequence = reference_sequence(ref, model->sequence_id);
+
+        // LEDs without a sequence are skipped
+        if (sequence == NULL)
+        {
+            model->pending = false;
+            continue;
+        }
+
+        if (!model->enabled && reference_rule(ref, LED_REFERENCE_DISABLED_PAUSED))
+        {
+            continue;
+        }
+
+        if (!model->pending && reference_rule(ref, LED_REFERENCE_STATIC_ONCE))
+        {
+            continue;
+        }
+
+        uint32_t step_ms = sequence->period / sequence->length;
+        bool frozen = false;
+
+        if (reference_rule(ref, LED_REFERENCE_PLAYBACK_RATE))
+        {
+            uint32_t scaled = ref->timer_period * model->playback_rate + model->playback_fraction;
+            model->timer_count += scaled / 256;
+            model->playback_fraction = scaled % 256;
+            frozen = model->playback_rate == 0;
+        }
+        else
+        {
+            model->timer_count += ref->timer_period;
+        }
+
+        // At most one step per update, time left over carries on to the next one. A rate of 0 never steps.
+        if (model->initialized && !model->held && !frozen && model->timer_count >= step_ms)
+        {
+            model->timer_count -= step_ms;
+
+            uint32_t last = sequence->length - 1;
+            uint32_t idx = model->sequence_idx < last ? model->sequence_idx : last;
+
+            if (idx != last)
+            {
+                model->sequence_idx = idx + 1;
+            }
+            else if (model->repeats_left == 0 || --model->repeats_left > 0)
+            {
+                model->sequence_idx = 0;
+            }
+            else if (model->next_sequence != -1)
+            {
+                // The last play is over, the next sequence starts from the beginning
+                model->sequence_id = model->next_sequence;
+                model->next_sequence = -1;
+                model->sequence_idx = 0;
+                model->timer_count = 0;
+                sequence = reference_sequence(ref, model->sequence_id);
+            }
+            else
+            {
+                model->sequence_idx = last;
+                model->timer_count = 0;
+                model->held = true;
+            }
+        }
+
+        // Disabled LEDs that keep moving aren't written
+        if (!model->enabled)
+        {
+            continue;
+        }
+
+        ref->write(model->pinout, sequence->sequence[model->sequence_idx]);
+
+        model->initialized = true;
+        model->pending = !reference_rule(ref, LED_REFERENCE_STATIC_ONCE) || (sequence->length > 1 && !model->held);
+    }
+}
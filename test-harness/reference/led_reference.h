@@ -0,0 +1,82 @@
+#ifndef LED_REFERENCE_H
+#define LED_REFERENCE_H
+
+// A deliberately simple model of the original led_update_state(), kept to check the optimised engines
+// against. Every registered LED is visited on every update in ID order, no masks, cursors, batching
+// or threads. With no rules turned on it does exactly what the original loop did: every LED with a
+// sequence moves on each update, enabled or not, and every enabled one is written. The changes the
+// engine has made to that on purpose are the led_reference_rule_t switches, so each difference from
+// the original is stated rather than built in. Covers registration, sequence assignment, enable, 
+// disable, offsets and periodic updates. Rate divisors, budgets, tickless updates, scenes and queued
+// commands are not modelled.
+
+#include "../../inc/led.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// The engine's intended changes to the original update, turned on one by one in led_reference_init()
+typedef enum
+{
+    // Static LEDs, a one step sequence or one held at its end, are written once after they are assigned,
+    // offset or enabled instead of on every update
+    LED_REFERENCE_STATIC_ONCE = 1 << 0,
+    // Disabled LEDs are paused where they are, the original kept stepping them without writing
+    LED_REFERENCE_DISABLED_PAUSED = 1 << 1,
+    // Repeat counts and chained sequences from led_assign_sequence_repeat(), the original looped forever
+    LED_REFERENCE_REPEATS = 1 << 2,
+    // Playback rates from led_set_playback_rate(), the original played sequences at their own speed
+    LED_REFERENCE_PLAYBACK_RATE = 1 << 3,
+    // Every change the current engine has
+    LED_REFERENCE_ALL_RULES = 0xF
+} led_reference_rule_t;
+
+typedef struct
+{
+    pins_t pinout;
+    bool enabled;
+    int32_t sequence_id;
+    uint32_t sequence_idx;
+    uint32_t timer_count;
+    bool initialized;   // the first state of the sequence has been written
+    bool pending;       // the LED has a state to write, with LED_REFERENCE_STATIC_ONCE static LEDs only write once
+    uint32_t repeats_left; // plays of the sequence left, 0 to loop forever
+    int32_t next_sequence;
+    bool held;          // the plays ran out with no next sequence, the last state stays
+    uint32_t playback_rate; // sequence time per 256 ms of real time
+    uint32_t playback_fraction; // sequence time under 1 ms carried to the next update, in 1/256 ms
+} led_reference_led_t;
+
+typedef struct
+{
+    led_reference_led_t leds[LEDS_MAX];
+    uint32_t count;
+    uint32_t timer_period;
+    uint32_t rules;     // led_reference_rule_t flags turned on
+    sequence_ctx_t * sequences;
+    led_write_fn_t write;
+} led_reference_t;
+
+// init function, the sequences are shared with the engine being checked. rules is 0 for the original update.
+void led_reference_init(led_reference_t * ref, sequence_ctx_t * sequences, uint32_t period_ms, uint32_t rules, led_write_fn_t write);
+
+// same results as led_ctx_register()
+int32_t led_reference_register(led_reference_t * ref, led_t led);
+
+// same results as led_ctx_assign_sequence()
+led_status_t led_reference_assign_sequence(led_reference_t * ref, int32_t led_id, int32_t sequence_id);
+
+// same results as led_ctx_assign_sequence_repeat(), without LED_REFERENCE_REPEATS it's a plain assignment
+led_status_t led_reference_assign_sequence_repeat(led_reference_t * ref, int32_t led_id, int32_t sequence_id, uint16_t repeats, int32_t next_sequence_id);
+
+void led_reference_enable(led_reference_t * ref, int32_t led_id);
+
+void led_reference_disable(led_reference_t * ref, int32_t led_id);
+
+void led_reference_offset_sequence(led_reference_t * ref, int32_t led_id, uint8_t offset);
+
+void led_reference_set_playback_rate(led_reference_t * ref, int32_t led_id, uint16_t rate);
+
+// one timer period passes, every enabled LED with something to show writes its state
+void led_reference_update_state(led_reference_t * ref);
+
+#endif
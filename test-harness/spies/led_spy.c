@@ -1,15 +1,84 @@
 #include "led_spy.h"
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 led_state_t led_states[LEDS_MAX] = {0};
 
+static FILE * vcd_file = NULL;
+static uint32_t vcd_count = 0;
+static char vcd_buffer[LED_SPY_VCD_BUFFER];
+static size_t vcd_used = 0;
+static uint32_t spy_time_ms = 0;
+static uint32_t vcd_time_ms = 0;
+static bool vcd_time_written = false;
+
+static void vcd_flush(void)
+{
+    fwrite(vcd_buffer, 1, vcd_used, vcd_file);
+    vcd_used = 0;
+}
+
+static void vcd_append(const char * text, size_t length)
+{
+    if (vcd_used + length > sizeof(vcd_buffer))
+    {
+        vcd_flush();
+    }
+
+    memcpy(&vcd_buffer[vcd_used], text, length);
+    vcd_used += length;
+}
+
+// VCD identifiers are strings of the printable characters '!' to '~'
+static size_t vcd_id(uint32_t id, char * out)
+{
+    size_t length = 0;
+
+    do
+    {
+        out[length++] = '!' + id % 94;
+        id /= 94;
+    } while (id > 0);
+
+    return length;
+}
+
+static void vcd_value(uint32_t id, led_state_t state)
+{
+    char line[16];
+    size_t length = 0;
+
+    line[length++] = state == LED_ON ? '1' : state == LED_OFF ? '0' : 'x';
+    length += vcd_id(id, &line[length]);
+    line[length++] = '\n';
+
+    vcd_append(line, length);
+}
+
+static void vcd_time(void)
+{
+    if (vcd_time_written && vcd_time_ms == spy_time_ms)
+    {
+        return;
+    }
+
+    char line[16];
+    int length = snprintf(line, sizeof(line), "#%u\n", (unsigned)spy_time_ms);
+
+    vcd_append(line, length);
+    vcd_time_ms = spy_time_ms;
+    vcd_time_written = true;
+}
+
 void led_spy_init(void)
 {
     for (int i = 0; i < LEDS_MAX; i++)
     {
         led_states[i] = LED_UNDEFINED;
     }
+
+    spy_time_ms = 0;
 }
 
 led_state_t led_spy_get_state(int32_t id)
@@ -29,6 +98,68 @@ led_state_t led_spy_set_state(int32_t id, led_state_t state)
         return LED_UNDEFINED;
     }
 
+    if (vcd_file != NULL && (uint32_t)id < vcd_count && led_states[id] != state)
+    {
+        vcd_time();
+        vcd_value(id, state);
+    }
+
     led_states[id] = state;
     return led_states[id];
+}
+
+void led_spy_set_time(uint32_t time_ms)
+{
+    spy_time_ms = time_ms;
+}
+
+bool led_spy_vcd_open(const char * path, uint32_t count)
+{
+    if (vcd_file != NULL)
+    {
+        led_spy_vcd_close();
+    }
+
+    vcd_file = fopen(path, "wb");
+    if (vcd_file == NULL)
+    {
+        return false;
+    }
+
+    vcd_count = count < LEDS_MAX ? count : LEDS_MAX;
+    vcd_used = 0;
+    vcd_time_written = false;
+
+    fprintf(vcd_file, "$timescale 1ms $end\n$scope module leds $end\n");
+    for (uint32_t i = 0; i < vcd_count; i++)
+    {
+        char id[8];
+        size_t length = vcd_id(i, id);
+        fprintf(vcd_file, "$var wire 1 %.*s led%u $end\n", (int)length, id, (unsigned)i);
+    }
+    fprintf(vcd_file, "$upscope $end\n$enddefinitions $end\n");
+
+    vcd_time();
+    vcd_append("$dumpvars\n", 10);
+    for (uint32_t i = 0; i < vcd_count; i++)
+    {
+        vcd_value(i, led_states[i]);
+    }
+    vcd_append("$end\n", 5);
+
+    return true;
+}
+
+void led_spy_vcd_close(void)
+{
+    if (vcd_file == NULL)
+    {
+        return;
+    }
+
+    // Mark the end so the last states are drawn up to the current time
+    vcd_time();
+    vcd_flush();
+    fclose(vcd_file);
+    vcd_file = NULL;
 }
\ No newline at end of file
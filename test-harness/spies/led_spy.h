@@ -6,9 +6,13 @@
 // led get state 
 #include "../../inc/led.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 #define DRIVER_TEST
 
+// Bytes of VCD output collected before they are written to the file
+#define LED_SPY_VCD_BUFFER 65536
+
 #define IS_LED_ON(id)\
         LONGS_EQUAL(LED_ON, led_spy_get_state(id));
 
@@ -25,5 +29,15 @@ void led_spy_init(void);
 led_state_t led_spy_get_state(int32_t id);
 led_state_t led_spy_set_state(int32_t id, led_state_t);
 
+// time in ms that the following state changes are recorded at in the VCD
+void led_spy_set_time(uint32_t time_ms);
+
+// starts streaming every state change of LEDs 0 to count - 1 into a Value Change Dump file that can
+// be opened in GTKWave. On is 1, off is 0 and undefined is x. Returns false if the file can't be opened.
+bool led_spy_vcd_open(const char * path, uint32_t count);
+
+// writes out the rest of the VCD and closes the file
+void led_spy_vcd_close(void);
+
 
 #endif
@@ -0,0 +1,83 @@
+#include "write_log.h"
+#include <stddef.h>
+
+static write_log_t shared_logs[WRITE_LOGS];
+
+static void shared_write_0(pins_t pins, led_state_t state)
+{
+    write_log_record(&shared_logs[0], 0, pins, state);
+}
+
+static void shared_write_1(pins_t pins, led_state_t state)
+{
+    write_log_record(&shared_logs[1], 0, pins, state);
+}
+
+static const led_write_fn_t shared_writes[WRITE_LOGS] = {shared_write_0, shared_write_1};
+
+void write_log_clear(write_log_t * log)
+{
+    log->count = 0;
+}
+
+void write_log_record(write_log_t * log, uint32_t time_ms, pins_t pins, led_state_t state)
+{
+    if (log->count < WRITE_LOG_MAX)
+    {
+        log->writes[log->count].time_ms = time_ms;
+        log->writes[log->count].pinout = pins;
+        log->writes[log->count].state = state;
+    }
+    log->count++;
+}
+
+const write_log_entry_t * write_log_get(const write_log_t * log, uint32_t n)
+{
+    if (n >= log->count || n >= WRITE_LOG_MAX)
+    {
+        return NULL;
+    }
+
+    return &log->writes[n];
+}
+
+int32_t write_log_compare(const write_log_t * expected, const write_log_t * actual)
+{
+    uint32_t count = expected->count < actual->count ? expected->count : actual->count;
+
+    for (uint32_t n = 0; n < count && n < WRITE_LOG_MAX; n++)
+    {
+        if (expected->writes[n].pinout.pin != actual->writes[n].pinout.pin ||
+            expected->writes[n].state != actual->writes[n].state)
+        {
+            return (int32_t)n;
+        }
+    }
+
+    if (expected->count != actual->count)
+    {
+        return (int32_t)count;
+    }
+
+    return -1;
+}
+
+write_log_t * write_log_shared(uint32_t n)
+{
+    if (n >= WRITE_LOGS)
+    {
+        return NULL;
+    }
+
+    return &shared_logs[n];
+}
+
+led_write_fn_t write_log_fn(uint32_t n)
+{
+    if (n >= WRITE_LOGS)
+    {
+        return NULL;
+    }
+
+    return shared_writes[n];
+}
@@ -0,0 +1,52 @@
+#ifndef WRITE_LOG_H
+#define WRITE_LOG_H
+
+// Records the writes an LED context makes, in the order it makes them. A context writes to one of
+// the shared logs through write_log_fn(), so two engines can be run side by side and compared
+// write by write. The timer fake keeps its own log with the virtual time of each write.
+#include "../../inc/led.h"
+#include <stdint.h>
+
+// Writes kept by a log, later ones are only counted
+#define WRITE_LOG_MAX 1024
+
+// Number of shared logs write_log_fn() has a write function for
+#define WRITE_LOGS 2
+
+#define WRITE_LOGS_MATCH(expected, actual)\
+        LONGS_EQUAL(-1, write_log_compare(expected, actual));
+
+typedef struct
+{
+    uint32_t time_ms;
+    pins_t pinout;
+    led_state_t state;
+} write_log_entry_t;
+
+typedef struct
+{
+    write_log_entry_t writes[WRITE_LOG_MAX];
+    uint32_t count;
+} write_log_t;
+
+// forgets the writes recorded so far
+void write_log_clear(write_log_t * log);
+
+// records a write made at time_ms
+void write_log_record(write_log_t * log, uint32_t time_ms, pins_t pins, led_state_t state);
+
+// the nth write recorded, NULL if it wasn't made or wasn't kept
+const write_log_entry_t * write_log_get(const write_log_t * log, uint32_t n);
+
+// index of the first write whose pin or state differs, or where one log ends before the other.
+// -1 if the logs match
+int32_t write_log_compare(const write_log_t * expected, const write_log_t * actual);
+
+// shared log n, NULL from WRITE_LOGS on
+write_log_t * write_log_shared(uint32_t n);
+
+// write function for led_ctx_set_write() that records into shared log n, NULL from WRITE_LOGS on
+led_write_fn_t write_log_fn(uint32_t n);
+
+
+#endif
@@ -0,0 +1,170 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+    #include "../../inc/led.h"
+    #include "../../inc/led_batch.h"
+    #include "../spies/write_log.h"
+    #include <string.h>
+}
+
+#ifdef LED_BATCH
+
+static write_log_t * scalar_log;
+static write_log_t * batch_log;
+
+// Events are compared in the contexts, they only need recording
+static void ignore_event(led_event_t event, uint32_t word, uint64_t mask)
+{
+}
+
+static sequence_ctx_t scalar_sequences;
+static sequence_ctx_t batch_sequences;
+static led_ctx_t scalar_ctx;
+static led_ctx_t batch_ctx;
+
+static uint8_t table[MAX_SEQUENCE + 3];
+static led_batch_t expected;
+static led_batch_t actual;
+
+TEST_GROUP(LEDBatchTest)
+{
+    uint32_t seed;
+
+    void setup()
+    {
+        seed = 12345;
+
+        led_ctx_init(&scalar_ctx, &scalar_sequences, 2);
+        led_ctx_init(&batch_ctx, &batch_sequences, 2);
+        led_ctx_set_write(&scalar_ctx, write_log_fn(0));
+        led_ctx_set_write(&batch_ctx, write_log_fn(1));
+        led_ctx_set_batch_update(&batch_ctx, true);
+        led_ctx_set_event_callback(&scalar_ctx, ignore_event);
+        led_ctx_set_event_callback(&batch_ctx, ignore_event);
+        scalar_log = write_log_shared(0);
+        batch_log = write_log_shared(1);
+        write_log_clear(scalar_log);
+        write_log_clear(batch_log);
+    }
+
+    void teardown()
+    {
+    }
+
+    uint32_t next_random()
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    }
+
+    // Sets up the same mix of LEDs in a context
+    void build_bank(led_ctx_t * ctx, sequence_ctx_t * sequences)
+    {
+        sequence_t blink = {.sequence = {LED_OFF, LED_ON}, .length = 2, .period = 10};
+        sequence_t pulse = {.sequence = {LED_ON, LED_OFF, LED_OFF}, .length = 3, .period = 9};
+        sequence_t fast = {.sequence = {LED_ON, LED_OFF, LED_ON, LED_OFF}, .length = 4, .period = 3};
+        int32_t ids[] = {
+            sequence_ctx_register(sequences, blink),
+            sequence_ctx_register(sequences, pulse),
+            sequence_ctx_register(sequences, fast)
+        };
+
+        for (int32_t i = 0; i < LEDS_MAX; i++)
+        {
+            led_t led = {.enabled = (i % 5) != 0, .pinout = {.pin = (uint32_t)i}, .sequence_id = -1};
+            led_ctx_register(ctx, led);
+
+            if (i % 6 == 5)
+            {
+                led_ctx_turn_on(ctx, i);
+                continue;
+            }
+
+            led_ctx_assign_sequence(ctx, i, ids[i % 3]);
+
+            if (i % 4 == 1)
+            {
+                // Some offsets are past the end of the sequence
+                led_ctx_offset_sequence(ctx, i, i % 6);
+            }
+
+            if (i % 8 == 3)
+            {
+                led_ctx_set_rate_divisor(ctx, i, 2);
+            }
+        }
+    }
+};
+
+// the vector kernel gives the same results as the scalar loop for every batch size
+TEST(LEDBatchTest, kernel_matches_scalar_loop)
+{
+    for (uint32_t i = 0; i < sizeof(table); i++)
+    {
+        table[i] = next_random();
+    }
+
+    for (uint32_t count = 0; count <= LED_BATCH_MAX; count++)
+    {
+        expected.count = count;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            expected.length[i] = 1 + next_random() % 8;
+            expected.idx[i] = next_random() % expected.length[i];
+            expected.seq_offset[i] = next_random() % (MAX_SEQUENCE - expected.length[i] + 1);
+            expected.step_ms[i] = next_random() % 4;
+            expected.timer_count[i] = (i % 9 == 0) ? UINT32_MAX - next_random() % 4 : next_random() % 6;
+        }
+
+        memcpy(&actual, &expected, sizeof(led_batch_t));
+
+        uint32_t elapsed = 1 + count % 3;
+        led_batch_advance_scalar(&expected, 0, elapsed, table);
+        led_batch_advance(&actual, elapsed, table);
+
+        MEMCMP_EQUAL(expected.timer_count, actual.timer_count, count * sizeof(uint32_t));
+        MEMCMP_EQUAL(expected.idx, actual.idx, count * sizeof(uint32_t));
+        MEMCMP_EQUAL(expected.state, actual.state, count * sizeof(uint32_t));
+    }
+}
+
+// updating with the batch kernel writes the same states in the same order as the scalar update
+TEST(LEDBatchTest, batch_update_matches_scalar_update)
+{
+    build_bank(&scalar_ctx, &scalar_sequences);
+    build_bank(&batch_ctx, &batch_sequences);
+
+    for (int step = 0; step < 100; step++)
+    {
+        write_log_clear(scalar_log);
+        write_log_clear(batch_log);
+
+        if (step == 30)
+        {
+            led_ctx_disable(&scalar_ctx, 2);
+            led_ctx_disable(&batch_ctx, 2);
+        }
+
+        if (step == 50)
+        {
+            led_ctx_enable(&scalar_ctx, 2);
+            led_ctx_enable(&batch_ctx, 2);
+        }
+
+        led_ctx_update_state(&scalar_ctx);
+        led_ctx_update_state(&batch_ctx);
+
+        WRITE_LOGS_MATCH(scalar_log, batch_log);
+        MEMCMP_EQUAL(scalar_ctx.event_masks, batch_ctx.event_masks, sizeof(scalar_ctx.event_masks));
+    }
+
+    for (int32_t i = 0; i < LEDS_MAX; i++)
+    {
+        LONGS_EQUAL(scalar_ctx.leds[i].sequence_idx, batch_ctx.leds[i].sequence_idx);
+        LONGS_EQUAL(scalar_ctx.leds[i].timer_count, batch_ctx.leds[i].timer_count);
+    }
+}
+
+#endif
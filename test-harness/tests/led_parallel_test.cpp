@@ -0,0 +1,125 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+    #include "../../inc/led.h"
+    #include "../../inc/led_parallel.h"
+    #include "../spies/write_log.h"
+}
+
+#ifdef LED_PARALLEL
+
+static write_log_t * serial_log;
+static write_log_t * parallel_log;
+
+static sequence_ctx_t serial_sequences;
+static sequence_ctx_t parallel_sequences;
+static led_ctx_t serial_ctx;
+static led_ctx_t parallel_ctx;
+static led_pool_t pool;
+
+TEST_GROUP(LEDParallelTest)
+{
+    void setup()
+    {
+        led_ctx_init(&serial_ctx, &serial_sequences, 1);
+        led_ctx_init(&parallel_ctx, &parallel_sequences, 1);
+        led_ctx_set_write(&serial_ctx, write_log_fn(0));
+        led_ctx_set_write(&parallel_ctx, write_log_fn(1));
+        serial_log = write_log_shared(0);
+        parallel_log = write_log_shared(1);
+        write_log_clear(serial_log);
+        write_log_clear(parallel_log);
+    }
+
+    void teardown()
+    {
+    }
+
+    // Sets up the same mix of LEDs in a context
+    void build_bank(led_ctx_t * ctx, sequence_ctx_t * sequences)
+    {
+        sequence_t blink = {.sequence = {LED_OFF, LED_ON}, .length = 2, .period = 10};
+        sequence_t pulse = {.sequence = {LED_ON, LED_OFF, LED_OFF}, .length = 3, .period = 9};
+        int32_t blink_id = sequence_ctx_register(sequences, blink);
+        int32_t pulse_id = sequence_ctx_register(sequences, pulse);
+
+        for (int32_t i = 0; i < LEDS_MAX; i++)
+        {
+            led_t led = {.enabled = (i % 7) != 0, .pinout = {.pin = (uint32_t)i}, .sequence_id = -1};
+            led_ctx_register(ctx, led);
+
+            switch (i % 4)
+            {
+                case 0:
+                    led_ctx_assign_sequence(ctx, i, blink_id);
+                    break;
+                case 1:
+                    led_ctx_assign_sequence(ctx, i, pulse_id);
+                    led_ctx_offset_sequence(ctx, i, i % 3);
+                    break;
+                case 2:
+                    led_ctx_turn_on(ctx, i);
+                    break;
+                default:
+                    led_ctx_assign_sequence(ctx, i, blink_id);
+                    led_ctx_set_rate_divisor(ctx, i, 3);
+                    break;
+            }
+        }
+    }
+};
+
+TEST(LEDParallelTest, pool_rejects_too_many_threads)
+{
+    LONGS_EQUAL(LED_ERR, led_pool_init(&pool, LED_PARALLEL_MAX_THREADS + 1));
+}
+
+// the parallel update writes the same states in the same order as the serial update
+TEST(LEDParallelTest, parallel_update_matches_serial_update)
+{
+    build_bank(&serial_ctx, &serial_sequences);
+    build_bank(&parallel_ctx, &parallel_sequences);
+
+    LONGS_EQUAL(LED_OK, led_pool_init(&pool, 4));
+
+    for (int step = 0; step < 50; step++)
+    {
+        write_log_clear(serial_log);
+        write_log_clear(parallel_log);
+
+        if (step == 20)
+        {
+            led_ctx_disable(&serial_ctx, 5);
+            led_ctx_disable(&parallel_ctx, 5);
+        }
+
+        led_ctx_update_state(&serial_ctx);
+        led_ctx_update_state_parallel(&parallel_ctx, &pool);
+
+        WRITE_LOGS_MATCH(serial_log, parallel_log);
+    }
+
+    led_pool_destroy(&pool);
+}
+
+// a pool without workers updates on the calling thread
+TEST(LEDParallelTest, pool_without_workers_updates_on_caller)
+{
+    build_bank(&serial_ctx, &serial_sequences);
+    build_bank(&parallel_ctx, &parallel_sequences);
+
+    LONGS_EQUAL(LED_OK, led_pool_init(&pool, 0));
+
+    for (int step = 0; step < 10; step++)
+    {
+        led_ctx_update_state(&serial_ctx);
+        led_ctx_update_state_parallel(&parallel_ctx, &pool);
+    }
+
+    WRITE_LOGS_MATCH(serial_log, parallel_log);
+
+    led_pool_destroy(&pool);
+}
+
+#endif
@@ -0,0 +1,314 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+    #include "../../inc/led.h"
+    #include "../../inc/led_parallel.h"
+    #include "../reference/led_reference.h"
+    #include "../spies/write_log.h"
+    #include <stdio.h>
+    #include <string.h>
+}
+
+// Runs the engine and the reference model side by side on random programs of registrations,
+// assignments with and without repeats, enables, disables, offsets, playback rates and updates, and reports the
+// first write that differs. The model is the original update with the engine's intended changes turned
+// on as rules; programs that none of the rules affect are also checked against the original update alone.
+
+#define REFERENCE_SEEDS 40
+#define REFERENCE_TICKS 2000
+
+typedef enum
+{
+    ENGINE_SERIAL,
+    ENGINE_BATCH,
+    ENGINE_PARALLEL
+} engine_t;
+
+static write_log_t * engine_writes;
+static write_log_t * reference_writes;
+
+static sequence_ctx_t sequences;
+static led_ctx_t ctx;
+static led_reference_t reference;
+
+static uint32_t random_next(uint32_t * state)
+{
+    // xorshift32, the same seed always gives the same program
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+TEST_GROUP(LEDReferenceTest)
+{
+#ifdef LED_PARALLEL
+    led_pool_t pool;
+#endif
+
+    void setup()
+    {
+#ifdef LED_PARALLEL
+        LONGS_EQUAL(LED_OK, led_pool_init(&pool, 3));
+#endif
+        engine_writes = write_log_shared(0);
+        reference_writes = write_log_shared(1);
+    }
+
+    void teardown()
+    {
+#ifdef LED_PARALLEL
+        led_pool_destroy(&pool);
+#endif
+    }
+
+    void update(engine_t engine)
+    {
+        switch (engine)
+        {
+#ifdef LED_PARALLEL
+            case ENGINE_PARALLEL:
+                led_ctx_update_state_parallel(&ctx, &pool);
+                break;
+#endif
+            default:
+                led_ctx_update_state(&ctx);
+                break;
+        }
+    }
+
+    void register_sequences(uint32_t * rng)
+    {
+        uint32_t sequence_count = 1 + random_next(rng) % (MAX_SEQUENCES - 2);
+
+        for (uint32_t s = 0; s < sequence_count; s++)
+        {
+            sequence_t sequence;
+            memset(&sequence, 0, sizeof(sequence));
+
+            // Mostly short sequences so they wrap often, some static ones and some with steps shorter than the timer
+            sequence.length = 1 + random_next(rng) % 12;
+            sequence.period = random_next(rng) % 400;
+
+            for (uint32_t i = 0; i < sequence.length; i++)
+            {
+                sequence.sequence[i] = random_next(rng) % 3;
+            }
+
+            sequence_ctx_register(&sequences, sequence);
+        }
+    }
+
+    // Applies one random change to both engines. Original programs only use what none of the rules change:
+    // enabled LEDs and animated sequences without repeats or playback rates.
+    void random_operation(uint32_t * rng, bool original)
+    {
+        uint32_t led_count = led_ctx_get_count(&ctx);
+        int32_t led_id = led_count ? random_next(rng) % (led_count + 1) : 0;
+
+        switch (random_next(rng) % 7)
+        {
+            case 0:
+            {
+                led_t led = {.enabled = original || (random_next(rng) % 4) != 0, .pinout = {.pin = led_count}, .sequence_id = -1};
+                LONGS_EQUAL(led_ctx_register(&ctx, led), led_reference_register(&reference, led));
+                break;
+            }
+            case 1:
+            {
+                // Includes IDs that don't exist
+                int32_t sequence_id = random_next(rng) % (sequences.count + 2);
+                sequence_t * sequence = sequence_ctx_get_from_id(&sequences, sequence_id);
+                if (original && (sequence == NULL || sequence->length <= 1))
+                {
+                    break;
+                }
+                LONGS_EQUAL(led_ctx_assign_sequence(&ctx, led_id, sequence_id),
+                    led_reference_assign_sequence(&reference, led_id, sequence_id));
+                break;
+            }
+            case 5:
+            {
+                if (original)
+                {
+                    break;
+                }
+                int32_t sequence_id = random_next(rng) % (sequences.count + 1);
+                int32_t next_sequence_id = (int32_t)(random_next(rng) % (sequences.count + 2)) - 1;
+                uint16_t repeats = random_next(rng) % 4;
+                LONGS_EQUAL(led_ctx_assign_sequence_repeat(&ctx, led_id, sequence_id, repeats, next_sequence_id),
+                    led_reference_assign_sequence_repeat(&reference, led_id, sequence_id, repeats, next_sequence_id));
+                break;
+            }
+            case 6:
+            {
+                if (original)
+                {
+                    break;
+                }
+                // Frozen, slowed, normal and sped up, including rates that leave fractions of a ms
+                static const uint16_t rates[] = {0, 64, 100, LED_RATE_1X, 300, 512, 1000};
+                uint16_t rate = rates[random_next(rng) % (sizeof(rates) / sizeof(rates[0]))];
+                led_ctx_set_playback_rate(&ctx, led_id, rate);
+                led_reference_set_playback_rate(&reference, led_id, rate);
+                break;
+            }
+            case 2:
+                led_ctx_enable(&ctx, led_id);
+                led_reference_enable(&reference, led_id);
+                break;
+            case 3:
+                if (original)
+                {
+                    break;
+                }
+                led_ctx_disable(&ctx, led_id);
+                led_reference_disable(&reference, led_id);
+                break;
+            default:
+            {
+                sequence_t * sequence = sequence_ctx_get_from_id(&sequences, led_id < (int32_t)led_count ? led_ctx_get_sequence_id(&ctx, led_id) : -1);
+                uint8_t offset = random_next(rng) % (sequence ? sequence->length : 4);
+                led_ctx_offset_sequence(&ctx, led_id, offset);
+                led_reference_offset_sequence(&reference, led_id, offset);
+                break;
+            }
+        }
+    }
+
+    // Runs one random program against a model with the given rules, returns false with a message at the
+    // first update where the writes differ
+    bool run_seed(uint32_t seed, engine_t engine, uint32_t rules, char * message, size_t size)
+    {
+        uint32_t rng = seed;
+        uint32_t period = 1 + random_next(&rng) % 20;
+
+        // Init registers the off and on sequences first
+        led_ctx_init(&ctx, &sequences, period);
+        led_ctx_set_write(&ctx, write_log_fn(0));
+        register_sequences(&rng);
+        led_reference_init(&reference, &sequences, period, rules, write_log_fn(1));
+
+#ifdef LED_BATCH
+        led_ctx_set_batch_update(&ctx, engine == ENGINE_BATCH);
+#endif
+
+        for (uint32_t tick = 0; tick < REFERENCE_TICKS; tick++)
+        {
+            uint32_t operations = random_next(&rng) % 4 == 0 ? random_next(&rng) % 4 : 0;
+            for (uint32_t n = 0; n < operations; n++)
+            {
+                random_operation(&rng, rules == 0);
+            }
+
+            write_log_clear(engine_writes);
+            write_log_clear(reference_writes);
+            update(engine);
+            led_reference_update_state(&reference);
+
+            if (!writes_match(seed, engine, tick, message, size))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool writes_match(uint32_t seed, engine_t engine, uint32_t tick, char * message, size_t size)
+    {
+        int32_t n = write_log_compare(reference_writes, engine_writes);
+
+        if (n < 0)
+        {
+            return true;
+        }
+
+        const write_log_entry_t * expected = write_log_get(reference_writes, n);
+        const write_log_entry_t * actual = write_log_get(engine_writes, n);
+
+        if (expected != NULL && actual != NULL)
+        {
+            snprintf(message, size, "engine %d seed %u tick %u write %u: expected LED %u state %d, got LED %u state %d",
+                engine, (unsigned)seed, (unsigned)tick, (unsigned)n, (unsigned)expected->pinout.pin, expected->state,
+                (unsigned)actual->pinout.pin, actual->state);
+        }
+        else
+        {
+            snprintf(message, size, "engine %d seed %u tick %u: expected %u writes, got %u",
+                engine, (unsigned)seed, (unsigned)tick, (unsigned)reference_writes->count, (unsigned)engine_writes->count);
+        }
+
+        return false;
+    }
+
+    void check_engine(engine_t engine, uint32_t rules)
+    {
+        char message[128];
+
+        for (uint32_t seed = 1; seed <= REFERENCE_SEEDS; seed++)
+        {
+            if (!run_seed(seed * 2654435761u, engine, rules, message, sizeof(message)))
+            {
+                FAIL(message);
+            }
+        }
+    }
+
+    // True if some program tells the engine apart from a model with the given rules
+    bool engine_differs(uint32_t rules)
+    {
+        char message[128];
+
+        for (uint32_t seed = 1; seed <= REFERENCE_SEEDS; seed++)
+        {
+            if (!run_seed(seed * 2654435761u, ENGINE_SERIAL, rules, message, sizeof(message)))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+// the serial update matches the reference
+TEST(LEDReferenceTest, serial_update_matches_reference)
+{
+    check_engine(ENGINE_SERIAL, LED_REFERENCE_ALL_RULES);
+}
+
+// on programs none of the rules affect the engine still does what the original update did
+TEST(LEDReferenceTest, serial_update_matches_original_update)
+{
+    check_engine(ENGINE_SERIAL, 0);
+}
+
+// every rule is a change the engine really makes, leaving any one out of the model is caught
+TEST(LEDReferenceTest, each_rule_is_needed)
+{
+    static const led_reference_rule_t rules[] = {LED_REFERENCE_STATIC_ONCE, LED_REFERENCE_DISABLED_PAUSED,
+        LED_REFERENCE_REPEATS, LED_REFERENCE_PLAYBACK_RATE};
+
+    for (uint32_t r = 0; r < sizeof(rules) / sizeof(rules[0]); r++)
+    {
+        CHECK_TEXT(engine_differs(LED_REFERENCE_ALL_RULES & ~rules[r]), "rule not needed");
+    }
+}
+
+#ifdef LED_BATCH
+// the batch kernel matches the reference
+TEST(LEDReferenceTest, batch_update_matches_reference)
+{
+    check_engine(ENGINE_BATCH, LED_REFERENCE_ALL_RULES);
+}
+#endif
+
+#ifdef LED_PARALLEL
+// the thread pool update matches the reference
+TEST(LEDReferenceTest, parallel_update_matches_reference)
+{
+    check_engine(ENGINE_PARALLEL, LED_REFERENCE_ALL_RULES);
+}
+#endif
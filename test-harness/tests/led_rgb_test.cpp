@@ -220,63 +220,50 @@ TEST(LEDRGBTest, Registering_1_rgb_sequences_registers_3_sequences)
     // Stuff
     uint32_t preRgbSeqCount = rgb_sequence_get_count();
     uint32_t preSeqCount = sequence_get_count();
-    // Register RGB sequence
-    uint32_t seq[1] = {C_WHITE};
+    // Register RGB sequence with 3 channels that aren't registered yet
+    uint32_t seq[1] = {0x102030};
     int32_t seqId = rgb_sequence_register(1, 1, seq);
     // Check that 1 extra RGB sequences exits
     ARE_N_RGB_SEQUENCES_REGISTERED(preRgbSeqCount + 1);
     // Check that 3 extra LED Sequnces exits
     ARE_N_SEQUENCES_REGISTERED(preSeqCount + 3);
-    // Check that the 3 LED Sequences contain only 255
-    check_sequence_matches_colour(seqId, C_WHITE);
+    check_sequence_matches_colour(seqId, 0x102030);
 }
 
-TEST(LEDRGBTest, Registering_red_rgb_sequences_registers_3_sequences)
+// Registering a colour that already exists returns the existing RGB sequence
+TEST(LEDRGBTest, Registering_built_in_colours_reuses_them)
 {
-    // Stuff
     uint32_t preRgbSeqCount = rgb_sequence_get_count();
     uint32_t preSeqCount = sequence_get_count();
-    // Register RGB sequence
-    uint32_t seq[1] = {C_RED};
-    int32_t seqId = rgb_sequence_register(1, 1, seq);
-    // Check that 1 extra RGB sequences exits
-    ARE_N_RGB_SEQUENCES_REGISTERED(preRgbSeqCount + 1);
-    // Check that 3 extra LED Sequnces exits
-    ARE_N_SEQUENCES_REGISTERED(preSeqCount + 3);
-    // Check that the 3 LED Sequences contain only 255
-    check_sequence_matches_colour(seqId, C_RED);
-}
+    uint32_t colours[] = {C_WHITE, C_RED, C_GREEN, C_BLUE, C_OFF};
+    int32_t ids[] = {RGB_WHITE, RGB_RED, RGB_GREEN, RGB_BLUE, RGB_OFF};
 
-TEST(LEDRGBTest, Registering_green_rgb_sequences_registers_3_sequences)
-{
-    // Stuff
-    uint32_t preRgbSeqCount = rgb_sequence_get_count();
-    uint32_t preSeqCount = sequence_get_count();
-    // Register RGB sequence
-    uint32_t seq[1] = {C_GREEN};
-    int32_t seqId = rgb_sequence_register(1, 1, seq);
-    // Check that 1 extra RGB sequences exits
-    ARE_N_RGB_SEQUENCES_REGISTERED(preRgbSeqCount + 1);
-    // Check that 3 extra LED Sequnces exits
-    ARE_N_SEQUENCES_REGISTERED(preSeqCount + 3);
-    // Check that the 3 LED Sequences contain only 255
-    check_sequence_matches_colour(seqId, C_GREEN);
+    for (int i = 0; i < 5; i++)
+    {
+        LONGS_EQUAL(ids[i], rgb_sequence_register(1, 1, &colours[i]));
+        check_sequence_matches_colour(ids[i], colours[i]);
+    }
+
+    ARE_N_RGB_SEQUENCES_REGISTERED(preRgbSeqCount);
+    ARE_N_SEQUENCES_REGISTERED(preSeqCount);
 }
 
-TEST(LEDRGBTest, Registering_blue_rgb_sequences_registers_3_sequences)
+// The 15 channels of the built in colours only use 2 sequences, full and 0
+TEST(LEDRGBTest, built_in_colours_share_channel_sequences)
 {
-    // Stuff
-    uint32_t preRgbSeqCount = rgb_sequence_get_count();
+    int32_t seqRedId = {0}, seqGreenId = {0}, seqBlueId = {0};
+    rgb_sequence_get_ids_from_id(RGB_RED, &seqRedId, &seqGreenId, &seqBlueId);
+    LONGS_EQUAL(seqGreenId, seqBlueId);
+    // White has 3 full channels, red, green and blue 1 each and off none
+    LONGS_EQUAL(6, sequence_get_refs(seqRedId));
+    CHECK(seqRedId != seqGreenId);
+
+    // A new colour reuses the channels that already exist
     uint32_t preSeqCount = sequence_get_count();
-    // Register RGB sequence
-    uint32_t seq[1] = {C_BLUE};
-    int32_t seqId = rgb_sequence_register(1, 1, seq);
-    // Check that 1 extra RGB sequences exits
-    ARE_N_RGB_SEQUENCES_REGISTERED(preRgbSeqCount + 1);
-    // Check that 3 extra LED Sequnces exits
-    ARE_N_SEQUENCES_REGISTERED(preSeqCount + 3);
-    // Check that the 3 LED Sequences contain only 255
-    check_sequence_matches_colour(seqId, C_BLUE);
+    uint32_t seq[1] = {0xFF0010};
+    rgb_sequence_register(1, 1, seq);
+    ARE_N_SEQUENCES_REGISTERED(preSeqCount + 1);
+    LONGS_EQUAL(7, sequence_get_refs(seqRedId));
 }
 
 // Sequence can be assigned to rgb led
@@ -330,19 +317,17 @@ TEST(LEDRGBTest, multiple_rgb_sequences_can_be_registered)
     // Stuff
     uint32_t preRgbSeqCount = rgb_sequence_get_count();
     uint32_t preSeqCount = sequence_get_count();
-    // Register RGB sequence
-    uint32_t seq_1[1] = {C_WHITE};
+    // Register RGB sequences with channels that aren't registered yet
+    uint32_t seq_1[1] = {0x102030};
     int32_t seqId_1 = rgb_sequence_register(1, 1, seq_1);
-    uint32_t seq_2[1] = {C_RED};
+    uint32_t seq_2[1] = {0x405060};
     int32_t seqId_2 = rgb_sequence_register(1, 1, seq_2);
     // Check that 1 extra RGB sequences exits
     ARE_N_RGB_SEQUENCES_REGISTERED(preRgbSeqCount + 2);
     // Check that 3 extra LED Sequnces exits
     ARE_N_SEQUENCES_REGISTERED(preSeqCount + 6);
-    // Checking white pattern
-    check_sequence_matches_colour(seqId_1, C_WHITE);
-    // Checking red pattern
-    check_sequence_matches_colour(seqId_2, C_RED);
+    check_sequence_matches_colour(seqId_1, 0x102030);
+    check_sequence_matches_colour(seqId_2, 0x405060);
 }
 
 // Turn an RGB LED on WHITE turns all leds on to full 255
@@ -479,11 +464,13 @@ TEST(LEDRGBTest, cannot_register_rgb_seq_when_there_is_already_max_seq_m2_regist
     int preSeq = sequence_get_count();
     for (int i = 0; i < ((MAX_SEQUENCES - preSeq) - 2); i++)
     {
-        define_and_register_sequence_super(4, 8, &sequence[0]);
+        // Identical sequences share a slot, so each one is different
+        sequence[4] = i;
+        define_and_register_sequence_super(5, 8, &sequence[0]);
     }
     ARE_N_SEQUENCES_REGISTERED(MAX_SEQUENCES - 2);
-    // Try to register RGB seq
-    uint32_t seq[1] = {C_RED};
+    // Try to register RGB seq that needs 3 new channels
+    uint32_t seq[1] = {0x102030};
     int32_t seqId = rgb_sequence_register(1, 1, seq);
     LONGS_EQUAL(-1, seqId);
     ARE_N_SEQUENCES_REGISTERED(MAX_SEQUENCES - 2);
@@ -3,6 +3,23 @@
 extern "C" 
 {
     #include "../spies/led_spy.h"
+    #include <stdio.h>
+    #include <string.h>
+}
+
+#define SPY_TEST_VCD "led_spy_test.vcd"
+
+// Reads back a whole file the spy wrote
+static const char * read_file(const char * path)
+{
+    static char contents[1024];
+    FILE * file = fopen(path, "rb");
+
+    size_t length = fread(contents, 1, sizeof(contents) - 1, file);
+    contents[length] = '\0';
+    fclose(file);
+
+    return contents;
 }
 
 
@@ -110,3 +127,56 @@ TEST(LEDSpyTest, dont_allow_setting_invalid_leds)
     LONGS_EQUAL(LED_UNDEFINED, led_spy_get_state(LEDS_MAX));
 }
 
+
+
+// every change of a dumped LED is written to the VCD with its time, repeats and other LEDs are left out
+TEST(LEDSpyTest, vcd_records_timed_transitions)
+{
+    CHECK(led_spy_vcd_open(SPY_TEST_VCD, 2));
+
+    led_spy_set_time(5);
+    led_spy_set_state(0, LED_ON);
+    led_spy_set_state(1, LED_OFF);
+    led_spy_set_state(2, LED_ON);
+
+    led_spy_set_time(7);
+    led_spy_set_state(0, LED_ON);
+
+    led_spy_set_time(9);
+    led_spy_set_state(0, LED_OFF);
+
+    led_spy_set_time(12);
+    led_spy_vcd_close();
+
+    STRCMP_EQUAL(
+        "$timescale 1ms $end\n"
+        "$scope module leds $end\n"
+        "$var wire 1 ! led0 $end\n"
+        "$var wire 1 \" led1 $end\n"
+        "$upscope $end\n"
+        "$enddefinitions $end\n"
+        "#0\n"
+        "$dumpvars\n"
+        "x!\n"
+        "x\"\n"
+        "$end\n"
+        "#5\n"
+        "1!\n"
+        "0\"\n"
+        "#9\n"
+        "0!\n"
+        "#12\n",
+        read_file(SPY_TEST_VCD));
+
+    remove(SPY_TEST_VCD);
+}
+
+// a file that can't be created is reported and nothing is recorded
+TEST(LEDSpyTest, vcd_open_fails_for_bad_path)
+{
+    CHECK_FALSE(led_spy_vcd_open("no_such_directory/led_spy_test.vcd", 1));
+
+    led_spy_set_state(0, LED_ON);
+    led_spy_vcd_close();
+    LONGS_EQUAL(LED_ON, led_spy_get_state(0));
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+    #include "../../inc/led.h"
+    #include "../../inc/led_stream.h"
+    #include "../spies/led_spy.h"
+}
+
+// Number of states the test producer makes before ending its stream
+static uint32_t produce_total;
+static uint32_t produced;
+static uint32_t fill_calls;
+
+// The state of step n of the test pattern, changing at uneven intervals so a repeated or skipped half shows
+static uint8_t pattern_state(uint32_t n)
+{
+    return ((n * 7) / 5) % 3 == 0 ? LED_ON : LED_OFF;
+}
+
+static uint32_t produce_pattern(int32_t stream_id, uint8_t * states, uint32_t count)
+{
+    uint32_t n = 0;
+
+    fill_calls++;
+
+    while (n < count && produced < produce_total)
+    {
+        states[n++] = pattern_state(produced++);
+    }
+
+    return n;
+}
+
+TEST_GROUP(LEDStreamTest)
+{
+    void setup()
+    {
+        led_init(1);
+        led_spy_init();
+        led_stream_init();
+
+        produce_total = 0;
+        produced = 0;
+        fill_calls = 0;
+    }
+
+    void teardown()
+    {
+    }
+
+    int32_t define_and_register_led_super(bool enabled, pins_t pinout)
+    {
+        led_t new_led = {
+            .enabled = enabled,
+            .pinout = pinout,
+            .sequence_id = -1,
+            .sequence_idx = 0,
+            .timer_count = 0,
+            .sequence_initialized = false
+        };
+
+        return led_register(new_led);
+    }
+
+    // Updates the LEDs and services the streams as a main loop would
+    void step_n_times(int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            led_update_state();
+            led_stream_service();
+        }
+    }
+};
+
+// a pattern many times longer than a sequence plays state by state and then holds its last state
+TEST(LEDStreamTest, long_pattern_plays_in_full)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    produce_total = 20 * MAX_SEQUENCE;
+
+    int32_t stream_id = led_stream_open(led_id, 8, 1, produce_pattern);
+    CHECK(stream_id != -1);
+    LONGS_EQUAL(LED_STREAM_PLAYING, led_stream_get_state(stream_id));
+
+    // The first state is written on the first update, then one step every update
+    for (uint32_t n = 0; n < produce_total; n++)
+    {
+        step_n_times(1);
+        LONGS_EQUAL(pattern_state(n), led_spy_get_state(0));
+    }
+
+    LONGS_EQUAL(LED_STREAM_DRAINING, led_stream_get_state(stream_id));
+
+    step_n_times(1);
+    LONGS_EQUAL(LED_STREAM_FINISHED, led_stream_get_state(stream_id));
+    step_n_times(50);
+    LONGS_EQUAL(pattern_state(produce_total - 1), led_spy_get_state(0));
+
+    // Asked for a half at a time, once more to find the end
+    LONGS_EQUAL(produce_total / 8 + 1, fill_calls);
+}
+
+// servicing more often than the updates run doesn't ask for states early or skip any
+TEST(LEDStreamTest, extra_services_between_updates)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    produce_total = 4 * MAX_SEQUENCE;
+
+    led_stream_open(led_id, 4, 1, produce_pattern);
+
+    for (uint32_t n = 0; n < produce_total; n++)
+    {
+        led_stream_service();
+        step_n_times(1);
+        led_stream_service();
+        LONGS_EQUAL(pattern_state(n), led_spy_get_state(0));
+    }
+
+    LONGS_EQUAL(produce_total / 4 + 1, fill_calls);
+}
+
+// a stream shorter than the buffer ends without any refills
+TEST(LEDStreamTest, short_pattern_holds_last_state)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    produce_total = 5;
+
+    int32_t stream_id = led_stream_open(led_id, 8, 2, produce_pattern);
+    LONGS_EQUAL(LED_STREAM_DRAINING, led_stream_get_state(stream_id));
+
+    // The first state is written at 1ms, the steps are at 2ms and every 2ms after
+    step_n_times(1);
+    LONGS_EQUAL(pattern_state(0), led_spy_get_state(0));
+
+    for (uint32_t n = 1; n < produce_total; n++)
+    {
+        step_n_times(1);
+        LONGS_EQUAL(pattern_state(n), led_spy_get_state(0));
+        step_n_times(1);
+        LONGS_EQUAL(pattern_state(n), led_spy_get_state(0));
+    }
+
+    step_n_times(2);
+    LONGS_EQUAL(LED_STREAM_FINISHED, led_stream_get_state(stream_id));
+    LONGS_EQUAL(1, fill_calls);
+    LONGS_EQUAL(pattern_state(produce_total - 1), led_spy_get_state(0));
+}
+
+// streams need an LED, a producer and a half that fits in a sequence
+TEST(LEDStreamTest, open_checks_arguments)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    produce_total = 1000;
+
+    LONGS_EQUAL(-1, led_stream_open(led_id + 1, 8, 1, produce_pattern));
+    LONGS_EQUAL(-1, led_stream_open(led_id, 0, 1, produce_pattern));
+    LONGS_EQUAL(-1, led_stream_open(led_id, LED_STREAM_HALF_MAX + 1, 1, produce_pattern));
+    LONGS_EQUAL(-1, led_stream_open(led_id, 8, 1, NULL));
+    LONGS_EQUAL(0, fill_calls);
+
+    for (int32_t i = 0; i < MAX_STREAMS; i++)
+    {
+        LONGS_EQUAL(i, led_stream_open(led_id, LED_STREAM_HALF_MAX, 1, produce_pattern));
+    }
+    LONGS_EQUAL(-1, led_stream_open(led_id, 8, 1, produce_pattern));
+    LONGS_EQUAL(LED_STREAM_CLOSED, led_stream_get_state(MAX_STREAMS));
+}
+
+// closing turns the LED off and frees the stream and its sequence
+TEST(LEDStreamTest, close_frees_the_stream)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint32_t sequences = sequence_get_count();
+    produce_total = 1000;
+
+    int32_t stream_id = led_stream_open(led_id, 8, 1, produce_pattern);
+    LONGS_EQUAL(sequences + 1, sequence_get_count());
+    step_n_times(3);
+
+    LONGS_EQUAL(LED_OK, led_stream_close(stream_id));
+    LONGS_EQUAL(LED_ERR, led_stream_close(stream_id));
+    LONGS_EQUAL(LED_STREAM_CLOSED, led_stream_get_state(stream_id));
+    LONGS_EQUAL(sequences, sequence_get_count());
+
+    step_n_times(1);
+    LONGS_EQUAL(LED_OFF, led_spy_get_state(0));
+    LONGS_EQUAL(stream_id, led_stream_open(led_id, 8, 1, produce_pattern));
+}
+
+// a stream's sequence isn't shared even when its content matches another sequence
+TEST(LEDStreamTest, stream_sequence_is_not_shared)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    int32_t other_id = define_and_register_led_super(true, {.pin = 1});
+    sequence_t off = {.sequence = {LED_OFF, LED_OFF}, .length = 2, .period = 2};
+    int32_t off_id = sequence_register(off);
+    led_assign_sequence(other_id, off_id);
+
+    // Ends straight away, so both halves hold LED_OFF
+    int32_t stream_id = led_stream_open(led_id, 1, 1, produce_pattern);
+    CHECK(led_get_sequence_id(led_id) != off_id);
+    LONGS_EQUAL(off_id, sequence_register(off));
+
+    step_n_times(2);
+    LONGS_EQUAL(LED_STREAM_FINISHED, led_stream_get_state(stream_id));
+    LONGS_EQUAL(2, sequence_get_from_id(off_id)->length);
+}
+
+// the LED is left alone once it has been given another sequence
+TEST(LEDStreamTest, reassigned_led_stops_the_stream)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    produce_total = 1000;
+
+    int32_t stream_id = led_stream_open(led_id, 8, 1, produce_pattern);
+    step_n_times(3);
+    led_turn_on(led_id);
+    step_n_times(100);
+
+    LONGS_EQUAL(LED_ON, led_spy_get_state(0));
+    LONGS_EQUAL(2, fill_calls);
+    LONGS_EQUAL(LED_STREAM_PLAYING, led_stream_get_state(stream_id));
+}
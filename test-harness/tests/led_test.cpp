@@ -650,8 +650,1067 @@ TEST(LEDTest, led_get_sequence_out_of_bounds_returns_error)
     LONGS_EQUAL(-1, bad_seq_id);
 }
 
+// a sequence updated mid-play keeps each LED's position and shows the new states from the next step
+TEST(LEDTest, updated_sequence_keeps_phase)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF, LED_OFF, LED_OFF, LED_OFF};
+    int32_t seq_id = define_and_register_sequence_super(4, 8, sequence);
+    led_assign_sequence(led_id, seq_id);
+
+    // First state at 1ms, then a step at 2ms and every 2ms after
+    step_n_times(4);
+    LONGS_EQUAL(2, led_get_from_id(led_id)->sequence_idx);
+
+    sequence_t inverted = {.sequence = {LED_ON, LED_ON, LED_ON, LED_ON}, .length = 4, .period = 8};
+    LONGS_EQUAL(LED_OK, led_update_sequence(seq_id, inverted));
+    LONGS_EQUAL(seq_id, led_get_sequence_id(led_id));
+
+    // The old state shows until the step that was due anyway, then the new one from the same place
+    step_n_times(1);
+    IS_LED_OFF(led_id);
+    LONGS_EQUAL(2, led_get_from_id(led_id)->sequence_idx);
+    step_n_times(1);
+    IS_LED_ON(led_id);
+    LONGS_EQUAL(3, led_get_from_id(led_id)->sequence_idx);
+}
+
+// LEDs with a single state are written again when their sequence is updated
+TEST(LEDTest, updated_static_sequence_is_written_again)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF};
+    int32_t seq_id = define_and_register_sequence_super(1, 1, sequence);
+    led_assign_sequence(led_id, seq_id);
+    step_n_times(1);
+    IS_LED_OFF(led_id);
+
+    sequence_t on = {.sequence = {LED_ON}, .length = 1, .period = 1};
+    LONGS_EQUAL(LED_OK, led_update_sequence(seq_id, on));
+    step_n_times(1);
+    IS_LED_ON(led_id);
+
+    LONGS_EQUAL(LED_ERR, led_update_sequence(MAX_SEQUENCES, on));
+}
+
+// content updated from the main loop between every update only changes what an LED shows on its steps
+TEST(LEDTest, sequence_updates_between_updates_only_show_on_steps)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF, LED_OFF, LED_OFF, LED_OFF};
+    int32_t seq_id = define_and_register_sequence_super(4, 12, sequence);
+    led_assign_sequence(led_id, seq_id);
+    step_n_times(2);
+
+    sequence_t on = {.sequence = {LED_ON, LED_ON, LED_ON, LED_ON}, .length = 4, .period = 12};
+    sequence_t off = {.sequence = {LED_OFF, LED_OFF, LED_OFF, LED_OFF}, .length = 4, .period = 12};
+    uint8_t last_idx = led_get_from_id(led_id)->sequence_idx;
+    led_state_t last_state = led_spy_get_state(0);
+    uint32_t changes = 0;
+
+    for (int n = 0; n < 24; n++)
+    {
+        LONGS_EQUAL(LED_OK, led_update_sequence(seq_id, n % 2 ? off : on));
+
+        // Only applied by the next update
+        LONGS_EQUAL(LED_ERR, led_update_sequence(seq_id, on));
+
+        step_n_times(1);
+
+        uint8_t idx = led_get_from_id(led_id)->sequence_idx;
+        led_state_t state = led_spy_get_state(0);
+
+        if (idx == last_idx)
+        {
+            LONGS_EQUAL(last_state, state);
+        }
+        else if (state != last_state)
+        {
+            changes++;
+        }
+
+        last_idx = idx;
+        last_state = state;
+    }
+
+    // 3ms steps, the content showing at each step alternates
+    CHECK(changes >= 6);
+}
+
+// an unregistered LED's slot is reused and its old ID is rejected
+TEST(LEDTest, unregistered_led_slot_is_reused_with_new_id)
+{
+    int32_t led_0 = define_and_register_led_super(true, {.pin = 0});
+    int32_t led_1 = define_and_register_led_super(true, {.pin = 1});
+    led_turn_on(led_0);
+
+    LONGS_EQUAL(LED_OK, led_unregister(led_0));
+    LONGS_EQUAL(LED_ERR, led_unregister(led_0));
+    ARE_N_LEDS_REGISTERED(1);
+    CHECK_FALSE(led_exists(led_0));
+    CHECK(led_exists(led_1));
+
+    // The slot comes back with the next generation
+    int32_t led_2 = define_and_register_led_super(true, {.pin = 2});
+    LONGS_EQUAL(HANDLE_SLOT(led_0), HANDLE_SLOT(led_2));
+    CHECK(led_0 != led_2);
+    ARE_N_LEDS_REGISTERED(2);
+
+    // The stale ID doesn't reach the LED now in the slot
+    LONGS_EQUAL(LED_ERR, led_assign_sequence(led_0, 1));
+    POINTERS_EQUAL(NULL, led_get_from_id(led_0));
+    LONGS_EQUAL(-1, led_get_sequence_id(led_2));
+
+    // The new LED starts clean and updates on its own pin
+    led_update_state();
+    IS_LED_UNDEFINED(0);
+    IS_LED_UNDEFINED(2);
+    led_turn_on(led_2);
+    led_update_state();
+    IS_LED_ON(2);
+    IS_LED_UNDEFINED(0);
+}
+
+// a full table has room again once an LED is unregistered
+TEST(LEDTest, unregister_makes_room_in_full_table)
+{
+    int32_t first = define_and_register_led_super(true, {.pin = 0});
+    for (int i = 1; i < LEDS_MAX; i++)
+    {
+        define_and_register_led_super(true, {.pin = 0});
+    }
+    LONGS_EQUAL(-1, define_and_register_led_super(true, {.pin = 0}));
+
+    led_unregister(first);
+    CHECK(define_and_register_led_super(true, {.pin = 0}) != -1);
+    LONGS_EQUAL(-1, define_and_register_led_super(true, {.pin = 0}));
+}
+
+// unregistering removes the LED's overlays and leaves the update loop
+TEST(LEDTest, unregister_removes_overlays_and_stops_updates)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    led_assign_sequence(led_id, define_and_register_sequence_super(2, 2, sequence));
+#ifdef LED_OVERLAYS
+    led_push_overlay(led_id, 1, 0, 5);
+#endif
+
+    LONGS_EQUAL(LED_OK, led_unregister(led_id));
+    LONGS_EQUAL(UINT32_MAX, led_get_next_wakeup());
+
+    led_update_state();
+    IS_LED_UNDEFINED(0);
+}
+
+
+
+
+// static LEDs are written once and then left out of the update loop
+TEST(LEDTest, static_led_is_only_written_once)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    led_turn_on(led_id);
+
+    step_n_times(1);
+    IS_LED_ON(led_id);
+
+    // Change the pin behind the driver's back, a static LED isn't rewritten
+    led_spy_set_state(0, LED_OFF);
+    step_n_times(10);
+    IS_LED_OFF(led_id);
+}
+
+// enabling a static LED writes its state again on the next update
+TEST(LEDTest, enabling_static_led_rewrites_it)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    led_turn_on(led_id);
+    step_n_times(1);
+
+    led_spy_set_state(0, LED_OFF);
+    led_disable(led_id);
+    step_n_times(1);
+    IS_LED_OFF(led_id);
+
+    led_enable(led_id);
+    step_n_times(1);
+    IS_LED_ON(led_id);
+}
+
+// a static LED that is later given an animated sequence animates again
+TEST(LEDTest, static_led_rejoins_update_loop_when_assigned_animated_sequence)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    led_turn_on(led_id);
+    step_n_times(5);
+
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    int32_t seq_id = define_and_register_sequence_super(2, 2, sequence);
+    led_assign_sequence(led_id, seq_id);
+
+    step_n_times(1);
+    IS_LED_OFF(led_id);
+    step_n_times(1);
+    IS_LED_ON(led_id);
+}
+
+// a mask assigns the same sequence to many LEDs at once
+TEST(LEDTest, assign_sequence_mask_assigns_every_led_in_mask)
+{
+    for (uint32_t pin = 0; pin < 4; pin++)
+    {
+        define_and_register_led_super(true, {.pin = pin});
+    }
 
+    LONGS_EQUAL(LED_OK, led_assign_sequence_mask(0, 0x5, 1));
+    step_n_times(1);
+
+    IS_LED_ON(0);
+    IS_LED_UNDEFINED(1);
+    IS_LED_ON(2);
+    IS_LED_UNDEFINED(3);
+}
+
+// a mask containing an unregistered LED is rejected without assigning anything
+TEST(LEDTest, assign_sequence_mask_with_unregistered_led_returns_error)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+
+    LONGS_EQUAL(LED_ERR, led_assign_sequence_mask(0, 0x3, 1));
+    LONGS_EQUAL(-1, led_get_sequence_id(led_id));
+    LONGS_EQUAL(LED_ERR, led_assign_sequence_mask(LED_MASK_WORDS, 0x1, 1));
+}
+
+// enable and disable masks only touch registered LEDs
+TEST(LEDTest, enable_and_disable_mask_update_enabled_mask)
+{
+    for (uint32_t pin = 0; pin < 3; pin++)
+    {
+        define_and_register_led_super(false, {.pin = pin});
+    }
+
+    led_enable_mask(0, UINT64_MAX);
+    LONGS_EQUAL(0x7, led_get_enabled_mask(0));
+
+    led_disable_mask(0, 0x2);
+    LONGS_EQUAL(0x5, led_get_enabled_mask(0));
+    CHECK_FALSE(led_is_enabled(1));
+    CHECK_FALSE(led_get_from_id(1)->enabled);
+    CHECK(led_get_from_id(2)->enabled);
+}
+
+// a disabled LED holds its place in the sequence until it is enabled again
+TEST(LEDTest, disabled_led_holds_its_place_in_sequence)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    int32_t seq_id = define_and_register_sequence_super(2, 2, sequence);
+    led_assign_sequence(led_id, seq_id);
+
+    step_n_times(1);
+    IS_LED_OFF(led_id);
+
+    led_disable(led_id);
+    step_n_times(3);
+
+    led_enable(led_id);
+    step_n_times(1);
+    IS_LED_ON(led_id);
+}
+
+// queued commands are only applied by the next update
+TEST(LEDTest, queued_assignment_is_applied_on_next_update)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+
+    LONGS_EQUAL(LED_OK, led_queue_assign_sequence(led_id, 1));
+    LONGS_EQUAL(-1, led_get_sequence_id(led_id));
+
+    step_n_times(1);
+
+    LONGS_EQUAL(1, led_get_sequence_id(led_id));
+    IS_LED_ON(led_id);
+}
+
+// queued commands are applied in the order they were queued
+TEST(LEDTest, queued_commands_are_applied_in_order)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+
+    led_queue_assign_sequence(led_id, 1);
+    led_queue_disable(led_id);
+    led_queue_assign_sequence(led_id, 0);
+    led_queue_enable(led_id);
+
+    step_n_times(1);
+
+    LONGS_EQUAL(0, led_get_sequence_id(led_id));
+    IS_LED_OFF(led_id);
+}
+
+// queueing fails once the queue is full or the led doesn't exist
+TEST(LEDTest, queue_rejects_commands_when_full_or_invalid)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+
+    LONGS_EQUAL(LED_ERR, led_queue_enable(led_id + 1));
+    LONGS_EQUAL(LED_ERR, led_queue_assign_sequence(led_id, sequence_get_count()));
+
+    for (int i = 0; i < LED_COMMAND_QUEUE_SIZE; i++)
+    {
+        LONGS_EQUAL(LED_OK, led_queue_enable(led_id));
+    }
+    LONGS_EQUAL(LED_ERR, led_queue_enable(led_id));
+
+    // Draining the queue makes room again
+    step_n_times(1);
+    LONGS_EQUAL(LED_OK, led_queue_enable(led_id));
+}
+
+// a snapshot is a copy of the LED's state
+TEST(LEDTest, snapshot_copies_led_state)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 3});
+    int32_t seq_id = define_and_register_sequence();
+    led_assign_sequence(led_id, seq_id);
+    step_n_times(1);
+
+    led_t snapshot;
+    LONGS_EQUAL(LED_OK, led_read_snapshot(led_id, &snapshot));
+
+    CHECK(snapshot.enabled);
+    LONGS_EQUAL(3, snapshot.pinout.pin);
+    LONGS_EQUAL(seq_id, snapshot.sequence_id);
+    CHECK(snapshot.sequence_initialized);
+
+    LONGS_EQUAL(LED_ERR, led_read_snapshot(led_id + 1, &snapshot));
+}
+
+// reading the table copies every registered LED up to the size of the output
+TEST(LEDTest, read_table_copies_registered_leds)
+{
+    define_and_register_led_super(true, {.pin = 0});
+    define_and_register_led_super(false, {.pin = 1});
+    define_and_register_led_super(true, {.pin = 2});
+
+    led_t table[LEDS_MAX];
+    LONGS_EQUAL(3, led_read_table(table, LEDS_MAX));
+    CHECK(table[0].enabled);
+    CHECK_FALSE(table[1].enabled);
+    LONGS_EQUAL(2, table[2].pinout.pin);
+
+    LONGS_EQUAL(2, led_read_table(table, 2));
+}
+
+// the off and on sequences led_turn_off() and led_turn_on() use can't be unregistered
+TEST(LEDTest, builtin_sequences_cannot_be_unregistered)
+{
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_unregister(0));
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_unregister(1));
+    CHECK(sequence_exists(0));
+    CHECK(sequence_exists(1));
+
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    led_turn_on(led_id);
+    led_update_state();
+    LONGS_EQUAL(LED_ON, led_spy_get_state(0));
+}
+
+// unregistered slots are marked in the table rather than copied as LEDs
+TEST(LEDTest, read_table_marks_unregistered_slots)
+{
+    define_and_register_led_super(true, {.pin = 0});
+    int32_t led_id = define_and_register_led_super(true, {.pin = 1});
+    define_and_register_led_super(true, {.pin = 2});
+    led_turn_on(led_id);
+    LONGS_EQUAL(LED_OK, led_unregister(led_id));
+
+    led_t table[LEDS_MAX];
+    LONGS_EQUAL(3, led_read_table(table, LEDS_MAX));
+    LONGS_EQUAL(-1, table[0].sequence_id);
+    LONGS_EQUAL(LED_SLOT_FREE, table[HANDLE_SLOT(led_id)].sequence_id);
+    CHECK_FALSE(table[HANDLE_SLOT(led_id)].enabled);
+    LONGS_EQUAL(2, table[2].pinout.pin);
+}
+
+// a budgeted update only services as many LEDs as it is allowed to
+TEST(LEDTest, budgeted_update_services_at_most_budget_leds)
+{
+    for (uint32_t pin = 0; pin < 4; pin++)
+    {
+        led_turn_on(define_and_register_led_super(true, {.pin = pin}));
+    }
 
+    led_update_state_budget(3);
+    IS_LED_ON(0);
+    IS_LED_ON(1);
+    IS_LED_ON(2);
+    IS_LED_UNDEFINED(3);
+
+    // The next call resumes where the last one left off
+    led_update_state_budget(1);
+    IS_LED_ON(3);
+}
+
+// priority LEDs are serviced before the others
+TEST(LEDTest, budgeted_update_services_priority_leds_first)
+{
+    for (uint32_t pin = 0; pin < 4; pin++)
+    {
+        led_turn_on(define_and_register_led_super(true, {.pin = pin}));
+    }
+    led_set_priority(3, true);
+    CHECK(led_is_priority(3));
+
+    led_update_state_budget(1);
+    IS_LED_UNDEFINED(0);
+    IS_LED_ON(3);
+}
+
+// an LED that misses updates catches up on its sequence when it is next serviced
+TEST(LEDTest, budgeted_update_catches_up_skipped_leds)
+{
+    int32_t led_0 = define_and_register_led_super(true, {.pin = 0});
+    int32_t led_1 = define_and_register_led_super(true, {.pin = 1});
+    uint8_t sequence[] = {LED_OFF, LED_ON, LED_OFF, LED_ON};
+    int32_t seq_id = define_and_register_sequence_super(4, 4, sequence);
+    led_assign_sequence(led_0, seq_id);
+    led_assign_sequence(led_1, seq_id);
+    led_set_priority(led_0, true);
+
+    // Write the first step of both, then starve led 1 for two calls
+    led_update_state();
+    led_update_state_budget(1);
+    led_update_state_budget(1);
+    IS_LED_OFF(1);
+
+    led_update_state_budget(2);
+
+    LONGS_EQUAL(3, led_get_from_id(led_0)->sequence_idx);
+    LONGS_EQUAL(3, led_get_from_id(led_1)->sequence_idx);
+    IS_LED_ON(1);
+}
+
+// a rate divided LED is only serviced every Nth update but keeps the sequence timing
+TEST(LEDTest, rate_divided_led_keeps_sequence_timing)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF, LED_OFF, LED_OFF, LED_OFF, LED_ON, LED_ON, LED_ON, LED_ON};
+    int32_t seq_id = define_and_register_sequence_super(8, 16, sequence);
+    led_assign_sequence(led_id, seq_id);
+    led_set_rate_divisor(led_id, 4);
+    LONGS_EQUAL(4, led_get_rate_divisor(led_id));
+
+    // LED 0 is first due on the 4th update
+    step_n_times(3);
+    IS_LED_UNDEFINED(led_id);
+    step_n_times(1);
+    IS_LED_OFF(led_id);
+
+    // 8 more updates plus the 4 waited for the first write is 6 steps of 2ms
+    step_n_times(8);
+    IS_LED_ON(led_id);
+    LONGS_EQUAL(6, led_get_from_id(led_id)->sequence_idx);
+}
+
+// a group of LEDs with a divisor is spread over the updates
+TEST(LEDTest, rate_divisor_mask_spreads_group_over_updates)
+{
+    for (uint32_t pin = 0; pin < 4; pin++)
+    {
+        led_turn_on(define_and_register_led_super(true, {.pin = pin}));
+    }
+    led_set_rate_divisor_mask(0, 0xF, 2);
+
+    step_n_times(1);
+    IS_LED_UNDEFINED(0);
+    IS_LED_ON(1);
+    IS_LED_UNDEFINED(2);
+    IS_LED_ON(3);
+
+    step_n_times(1);
+    IS_LED_ON(0);
+    IS_LED_ON(2);
+}
+
+// a half speed LED takes twice as long over each step of the same sequence
+TEST(LEDTest, half_playback_rate_slows_sequence)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    led_assign_sequence(led_id, define_and_register_sequence_super(2, 4, sequence));
+    led_set_playback_rate(led_id, LED_RATE_1X / 2);
+    LONGS_EQUAL(LED_RATE_1X / 2, led_get_playback_rate(led_id));
+
+    // At normal speed the LED would turn on on the 2nd update
+    step_n_times(3);
+    IS_LED_OFF(led_id);
+    step_n_times(1);
+    IS_LED_ON(led_id);
+}
+
+// a double speed LED steps twice as often and a frozen one stays where it is
+TEST(LEDTest, playback_rate_mask_speeds_up_and_freezes_group)
+{
+    uint8_t sequence[] = {LED_OFF, LED_ON, LED_OFF, LED_ON};
+    int32_t seq_id = define_and_register_sequence_super(4, 16, sequence);
+    for (uint32_t pin = 0; pin < 3; pin++)
+    {
+        led_assign_sequence(define_and_register_led_super(true, {.pin = pin}), seq_id);
+    }
+    led_set_playback_rate_mask(0, 0x3, 2 * LED_RATE_1X);
+    led_set_playback_rate(2, 0);
+
+    step_n_times(4);
+    LONGS_EQUAL(2, led_get_from_id(0)->sequence_idx);
+    LONGS_EQUAL(2, led_get_from_id(1)->sequence_idx);
+    LONGS_EQUAL(0, led_get_from_id(2)->sequence_idx);
+    IS_LED_OFF(2);
+
+    // The rate stays when a new sequence is assigned
+    led_assign_sequence(0, seq_id);
+    LONGS_EQUAL(2 * LED_RATE_1X, led_get_playback_rate(0));
+    LONGS_EQUAL(0, led_get_playback_rate(-1));
+}
+
+// a tickless build sleeps for the real time a step takes at the LED's rate
+TEST(LEDTest, next_wakeup_follows_playback_rate)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    led_assign_sequence(led_id, define_and_register_sequence_super(2, 20, sequence));
+    led_set_playback_rate(led_id, LED_RATE_1X / 2);
+
+    led_update_elapsed(0);
+    IS_LED_OFF(led_id);
+
+    LONGS_EQUAL(20, led_get_next_wakeup());
+    led_update_elapsed(19);
+    IS_LED_OFF(led_id);
+    led_update_elapsed(1);
+    IS_LED_ON(led_id);
+
+    led_set_playback_rate(led_id, 0);
+    CHECK(led_get_next_wakeup() > 1000000);
+}
+
+// without tolerance a tickless build wakes for each LED's transition
+TEST(LEDTest, next_wakeup_is_the_earliest_transition)
+{
+    LONGS_EQUAL(UINT32_MAX, led_get_next_wakeup());
+
+    int32_t led_0 = define_and_register_led_super(true, {.pin = 0});
+    int32_t led_1 = define_and_register_led_super(true, {.pin = 1});
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    led_assign_sequence(led_0, define_and_register_sequence_super(2, 20, sequence));
+    led_assign_sequence(led_1, define_and_register_sequence_super(2, 26, sequence));
+
+    // First states are pending so the wakeup is immediate
+    LONGS_EQUAL(0, led_get_next_wakeup());
+    led_update_elapsed(0);
+    IS_LED_OFF(0);
+    IS_LED_OFF(1);
+
+    LONGS_EQUAL(10, led_get_next_wakeup());
+    led_update_elapsed(10);
+    IS_LED_ON(0);
+    IS_LED_OFF(1);
+
+    LONGS_EQUAL(3, led_get_next_wakeup());
+    led_update_elapsed(3);
+    IS_LED_ON(1);
+}
+
+// transitions within an LED's tolerance of another are written in the same wakeup
+TEST(LEDTest, tolerance_coalesces_nearby_transitions)
+{
+    int32_t led_0 = define_and_register_led_super(true, {.pin = 0});
+    int32_t led_1 = define_and_register_led_super(true, {.pin = 1});
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    led_assign_sequence(led_0, define_and_register_sequence_super(2, 20, sequence));
+    led_assign_sequence(led_1, define_and_register_sequence_super(2, 26, sequence));
+    led_set_tolerance(led_0, 5);
+    led_update_elapsed(0);
+
+    // LED 0 can wait until LED 1's transition at 13ms
+    LONGS_EQUAL(13, led_get_next_wakeup());
+    led_update_elapsed(13);
+    IS_LED_ON(0);
+    IS_LED_ON(1);
+}
+
+static led_state_t bank_a_state[LEDS_MAX];
+static led_state_t bank_b_state[LEDS_MAX];
+
+static void bank_a_write(pins_t pins, led_state_t state)
+{
+    bank_a_state[pins.pin] = state;
+}
+
+static void bank_b_write(pins_t pins, led_state_t state)
+{
+    bank_b_state[pins.pin] = state;
+}
+
+// each context has its own LEDs, sequences, timer period and output
+TEST(LEDTest, contexts_run_independent_banks)
+{
+    static sequence_ctx_t sequences_a;
+    static sequence_ctx_t sequences_b;
+    static led_ctx_t bank_a;
+    static led_ctx_t bank_b;
+
+    memset(bank_a_state, LED_UNDEFINED, sizeof(bank_a_state));
+    memset(bank_b_state, LED_UNDEFINED, sizeof(bank_b_state));
+
+    led_ctx_init(&bank_a, &sequences_a, 1);
+    led_ctx_init(&bank_b, &sequences_b, 5);
+    led_ctx_set_write(&bank_a, bank_a_write);
+    led_ctx_set_write(&bank_b, bank_b_write);
+
+    led_t new_led = {.enabled = true, .pinout = {.pin = 0}, .sequence_id = -1};
+    int32_t led_a = led_ctx_register(&bank_a, new_led);
+    int32_t led_b = led_ctx_register(&bank_b, new_led);
+
+    sequence_t blink = {.sequence = {LED_OFF, LED_ON}, .length = 2, .period = 10};
+    int32_t seq_a = sequence_ctx_register(&sequences_a, blink);
+    LONGS_EQUAL(seq_a, sequence_ctx_register(&sequences_b, blink));
+    LONGS_EQUAL(2, sequence_get_count());
+
+    led_ctx_assign_sequence(&bank_a, led_a, seq_a);
+    led_ctx_assign_sequence(&bank_b, led_b, seq_a);
+
+    // One update of bank B covers as much time as five of bank A
+    led_ctx_update_state(&bank_a);
+    led_ctx_update_state(&bank_b);
+    LONGS_EQUAL(LED_OFF, bank_a_state[0]);
+    LONGS_EQUAL(LED_OFF, bank_b_state[0]);
+
+    for (int i = 0; i < 3; i++)
+    {
+        led_ctx_update_state(&bank_a);
+    }
+    LONGS_EQUAL(LED_OFF, bank_a_state[0]);
+
+    led_ctx_update_state(&bank_a);
+    LONGS_EQUAL(LED_ON, bank_a_state[0]);
+    LONGS_EQUAL(LED_OFF, bank_b_state[0]);
+
+    led_ctx_update_state(&bank_b);
+    LONGS_EQUAL(LED_ON, bank_b_state[0]);
+
+    // The default context and the spy are untouched
+    LONGS_EQUAL(0, led_get_count());
+    LONGS_EQUAL(1, led_ctx_get_count(&bank_a));
+    IS_LED_UNDEFINED(0);
+}
+
+// a sequence with a repeat count plays that many times then moves on to the next sequence by itself
+TEST(LEDTest, repeat_count_chains_to_next_sequence)
+{
+    int32_t led_id = define_and_register_led();
+
+    uint8_t blink[] = {LED_ON, LED_OFF};
+    int32_t blink_id = define_and_register_sequence_super(2, 2, blink);
+
+    // Blink 3 times then stay on
+    LONGS_EQUAL(LED_OK, led_assign_sequence_repeat(led_id, blink_id, 3, 1));
+
+    for (int play = 0; play < 3; play++)
+    {
+        led_update_state();
+        IS_LED_ON(led_id);
+        led_update_state();
+        IS_LED_OFF(led_id);
+    }
+
+    led_update_state();
+    IS_LED_ON(led_id);
+    LONGS_EQUAL(1, led_get_sequence_id(led_id));
+
+    // The solid sequence is static so it isn't written again
+    led_spy_set_state(led_id, LED_UNDEFINED);
+    led_update_state();
+    IS_LED_UNDEFINED(led_id);
+}
+
+// a one-shot sequence with nothing after it holds its last state
+TEST(LEDTest, one_shot_sequence_holds_last_state)
+{
+    int32_t led_id = define_and_register_led();
+
+    uint8_t ramp[] = {LED_OFF, LED_ON, LED_OFF, LED_ON};
+    int32_t ramp_id = define_and_register_sequence_super(4, 4, ramp);
+
+    LONGS_EQUAL(LED_OK, led_assign_sequence_repeat(led_id, ramp_id, 1, -1));
+
+    // The step after the last state ends the play and writes the held state once more
+    for (int i = 0; i < 5; i++)
+    {
+        led_update_state();
+    }
+    IS_LED_ON(led_id);
+
+    // Holding, no more writes
+    led_spy_set_state(led_id, LED_UNDEFINED);
+    for (int i = 0; i < 10; i++)
+    {
+        led_update_state();
+    }
+    IS_LED_UNDEFINED(led_id);
+    LONGS_EQUAL(ramp_id, led_get_sequence_id(led_id));
+
+    // A plain assignment loops forever again
+    led_assign_sequence(led_id, ramp_id);
+    for (int i = 0; i < 5; i++)
+    {
+        led_update_state();
+    }
+    IS_LED_OFF(led_id);
+}
+
+// a repeat assignment with a next sequence that doesn't exist is rejected
+TEST(LEDTest, repeat_assignment_checks_next_sequence)
+{
+    int32_t led_id = define_and_register_led();
+
+    LONGS_EQUAL(LED_ERR, led_assign_sequence_repeat(led_id, 1, 2, 50));
+    LONGS_EQUAL(LED_ERR, led_assign_sequence_repeat(led_id + 1, 1, 2, 0));
+    LONGS_EQUAL(-1, led_get_sequence_id(led_id));
+}
+
+#ifdef LED_OVERLAYS
+// when a timed overlay expires the base pattern carries on in step with an LED that was never covered
+TEST(LEDTest, overlay_expires_and_base_resumes_in_phase)
+{
+    int32_t covered = define_and_register_led_super(true, {.pin = 0});
+    int32_t uncovered = define_and_register_led_super(true, {.pin = 1});
+
+    uint8_t pattern[] = {LED_ON, LED_OFF, LED_OFF, LED_ON, LED_OFF};
+    int32_t base_id = define_and_register_sequence_super(5, 15, pattern);
+    led_assign_sequence(covered, base_id);
+    led_assign_sequence(uncovered, base_id);
+
+    for (int i = 0; i < 7; i++)
+    {
+        led_update_state();
+    }
+
+    // Solid on for 20ms
+    LONGS_EQUAL(LED_OK, led_push_overlay(covered, 1, 0, 20));
+    LONGS_EQUAL(1, led_get_overlay_count(covered));
+    LONGS_EQUAL(1, led_get_sequence_id(covered));
+
+    for (int i = 0; i < 19; i++)
+    {
+        led_update_state();
+        IS_LED_ON(0);
+    }
+
+    for (int i = 0; i < 30; i++)
+    {
+        led_update_state();
+        LONGS_EQUAL(led_spy_get_state(1), led_spy_get_state(0));
+    }
+    LONGS_EQUAL(0, led_get_overlay_count(covered));
+    LONGS_EQUAL(base_id, led_get_sequence_id(covered));
+}
+
+// the highest priority overlay is shown, lower ones come back from their start when it's removed
+TEST(LEDTest, overlays_stack_by_priority)
+{
+    int32_t led_id = define_and_register_led();
+    led_assign_sequence(led_id, 0);
+
+    uint8_t blink[] = {LED_ON, LED_OFF};
+    int32_t blink_id = define_and_register_sequence_super(2, 2, blink);
+
+    led_update_state();
+    IS_LED_OFF(led_id);
+
+    LONGS_EQUAL(LED_OK, led_push_overlay(led_id, blink_id, 5, 0));
+    // Lower priority goes underneath, not shown
+    LONGS_EQUAL(LED_OK, led_push_overlay(led_id, 1, 1, 0));
+    LONGS_EQUAL(LED_ERR, led_push_overlay(led_id, 1, 9, 0));
+    LONGS_EQUAL(blink_id, led_get_sequence_id(led_id));
+
+    led_update_state();
+    IS_LED_ON(led_id);
+    led_update_state();
+    IS_LED_OFF(led_id);
+
+    LONGS_EQUAL(LED_OK, led_pop_overlay(led_id));
+    led_update_state();
+    IS_LED_ON(led_id);
+    LONGS_EQUAL(1, led_get_sequence_id(led_id));
+
+    LONGS_EQUAL(LED_OK, led_pop_overlay(led_id));
+    LONGS_EQUAL(LED_ERR, led_pop_overlay(led_id));
+    led_update_state();
+    IS_LED_OFF(led_id);
+}
+
+// assigning a sequence while an overlay is shown changes what comes back afterwards
+TEST(LEDTest, assignment_under_overlay_changes_base)
+{
+    int32_t led_id = define_and_register_led();
+    led_assign_sequence(led_id, 0);
+
+    led_push_overlay(led_id, 1, 0, 5);
+    led_assign_sequence(led_id, 0);
+    led_assign_sequence(led_id, 1);
+    LONGS_EQUAL(1, led_get_overlay_count(led_id));
+
+    led_update_state();
+    IS_LED_ON(led_id);
+
+    led_clear_overlays(led_id);
+    LONGS_EQUAL(0, led_get_overlay_count(led_id));
+    LONGS_EQUAL(1, led_get_sequence_id(led_id));
+    led_spy_set_state(led_id, LED_UNDEFINED);
+    led_update_state();
+    IS_LED_ON(led_id);
+}
+
+// a tickless build wakes up to take an overlay down
+TEST(LEDTest, next_wakeup_includes_overlay_expiry)
+{
+    int32_t led_id = define_and_register_led();
+    led_assign_sequence(led_id, 0);
+    led_update_state();
+
+    led_push_overlay(led_id, 1, 0, 250);
+    led_update_elapsed(10);
+
+    LONGS_EQUAL(240, led_get_next_wakeup());
+    led_update_elapsed(240);
+    IS_LED_OFF(led_id);
+}
+#endif
+
+static uint64_t event_masks[LED_EVENT_COUNT];
+static uint32_t event_calls = 0;
+
+static void record_event(led_event_t event, uint32_t word, uint64_t mask)
+{
+    event_masks[event] |= mask;
+    event_calls++;
+}
+
+// events are recorded by the update and only reach the callback when they are dispatched
+TEST(LEDTest, cycle_events_are_deferred_and_coalesced)
+{
+    memset(event_masks, 0, sizeof(event_masks));
+    event_calls = 0;
+    led_set_event_callback(record_event);
+
+    int32_t fast = define_and_register_led();
+    int32_t slow = define_and_register_led();
+    int32_t steady = define_and_register_led();
+
+    uint8_t blink[] = {LED_ON, LED_OFF};
+    led_assign_sequence(fast, define_and_register_sequence_super(2, 2, blink));
+    led_assign_sequence(slow, define_and_register_sequence_super(2, 20, blink));
+    led_assign_sequence(steady, 1);
+
+    // The fast LED wraps twice, nothing is reported until the dispatch
+    for (int i = 0; i < 5; i++)
+    {
+        led_update_state();
+    }
+    LONGS_EQUAL(0, event_calls);
+
+    // Both wraps in one call
+    LONGS_EQUAL(1, led_dispatch_events());
+    LONGS_EQUAL(1, event_calls);
+    LONGS_EQUAL((uint64_t)1 << fast, event_masks[LED_EVENT_CYCLE]);
+    LONGS_EQUAL(0, event_masks[LED_EVENT_FINISHED]);
+
+    // Nothing new
+    LONGS_EQUAL(0, led_dispatch_events());
+
+    for (int i = 0; i < 20; i++)
+    {
+        led_update_state();
+    }
+    LONGS_EQUAL(1, led_dispatch_events());
+    LONGS_EQUAL(((uint64_t)1 << fast) | ((uint64_t)1 << slow), event_masks[LED_EVENT_CYCLE]);
+}
+
+// a sequence with a repeat count reports when it finishes
+TEST(LEDTest, finished_event_raised_when_repeats_run_out)
+{
+    memset(event_masks, 0, sizeof(event_masks));
+    event_calls = 0;
+    led_set_event_callback(record_event);
+
+    int32_t led_id = define_and_register_led();
+    uint8_t blink[] = {LED_ON, LED_OFF};
+    led_assign_sequence_repeat(led_id, define_and_register_sequence_super(2, 2, blink), 2, 1);
+
+    for (int i = 0; i < 4; i++)
+    {
+        led_update_state();
+    }
+    led_dispatch_events();
+    LONGS_EQUAL(0, event_masks[LED_EVENT_FINISHED]);
+
+    led_update_state();
+    led_dispatch_events();
+    LONGS_EQUAL((uint64_t)1 << led_id, event_masks[LED_EVENT_FINISHED]);
+    LONGS_EQUAL((uint64_t)1 << led_id, event_masks[LED_EVENT_CYCLE]);
+}
+
+// without a callback nothing is recorded
+TEST(LEDTest, events_not_recorded_without_callback)
+{
+    event_calls = 0;
+
+    int32_t led_id = define_and_register_led();
+    uint8_t blink[] = {LED_ON, LED_OFF};
+    led_assign_sequence(led_id, define_and_register_sequence_super(2, 2, blink));
+
+    for (int i = 0; i < 5; i++)
+    {
+        led_update_state();
+    }
+
+    led_set_event_callback(record_event);
+    LONGS_EQUAL(0, led_dispatch_events());
+    LONGS_EQUAL(0, event_calls);
+}
+
+#ifdef LED_INSTRUMENTATION
+static uint32_t fake_cycles = 0;
+static uint32_t fake_cycles_step = 0;
+
+// Each read moves the counter on by the step, so an update takes one step
+static uint32_t fake_cycle_counter(void)
+{
+    uint32_t now = fake_cycles;
+    fake_cycles += fake_cycles_step;
+    return now;
+}
+
+// every update is timed and the stats come back through the read API
+TEST(LEDTest, update_timing_is_recorded)
+{
+    led_stats_t stats;
+
+    fake_cycles = 0;
+    fake_cycles_step = 100;
+    led_set_cycle_counter(fake_cycle_counter, 150);
+    define_and_register_led();
+
+    led_update_state();
+    fake_cycles_step = 200;
+    led_update_state();
+    fake_cycles_step = 0;
+    led_update_state();
+
+    LONGS_EQUAL(LED_OK, led_get_stats(&stats));
+    LONGS_EQUAL(3, stats.calls);
+    LONGS_EQUAL(0, stats.min_cycles);
+    LONGS_EQUAL(200, stats.max_cycles);
+    LONGS_EQUAL(100, stats.mean_cycles);
+    LONGS_EQUAL(300, stats.total_cycles);
+    LONGS_EQUAL(1, stats.overruns);
+
+    // 0 cycles, 64 to 127 cycles and 128 to 255 cycles
+    LONGS_EQUAL(1, stats.histogram[0]);
+    LONGS_EQUAL(1, stats.histogram[7]);
+    LONGS_EQUAL(1, stats.histogram[8]);
+
+    led_reset_stats();
+    LONGS_EQUAL(LED_OK, led_get_stats(&stats));
+    LONGS_EQUAL(0, stats.calls);
+    LONGS_EQUAL(0, stats.mean_cycles);
+    LONGS_EQUAL(0, stats.histogram[8]);
+}
+
+// without a counter nothing is timed
+TEST(LEDTest, update_timing_is_off_by_default)
+{
+    led_stats_t stats;
+
+    led_update_state();
+    led_update_elapsed(5);
+
+    LONGS_EQUAL(LED_OK, led_get_stats(&stats));
+    LONGS_EQUAL(0, stats.calls);
+    LONGS_EQUAL(LED_ERR, led_get_stats(NULL));
+}
+#endif
+
+#ifdef LED_TRACE
+// only writes that change an LED's state are traced, with the time they were made
+TEST(LEDTest, trace_records_transitions)
+{
+    led_trace_entry_t trace[8];
+
+    int32_t blinking = define_and_register_led();
+    int32_t steady = define_and_register_led();
+
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    led_assign_sequence(blinking, define_and_register_sequence_super(2, 4, sequence));
+    led_assign_sequence(steady, 1);
+
+    for (int i = 0; i < 6; i++)
+    {
+        led_update_state();
+    }
+
+    LONGS_EQUAL(5, led_get_trace_count());
+    LONGS_EQUAL(5, led_read_trace(trace, 8));
+
+    LONGS_EQUAL(1, trace[0].time_ms);
+    LONGS_EQUAL(blinking, trace[0].led_id);
+    LONGS_EQUAL(LED_UNDEFINED, trace[0].old_state);
+    LONGS_EQUAL(LED_OFF, trace[0].new_state);
+
+    LONGS_EQUAL(1, trace[1].time_ms);
+    LONGS_EQUAL(steady, trace[1].led_id);
+
+    LONGS_EQUAL(2, trace[2].time_ms);
+    LONGS_EQUAL(LED_OFF, trace[2].old_state);
+    LONGS_EQUAL(LED_ON, trace[2].new_state);
+
+    LONGS_EQUAL(4, trace[3].time_ms);
+    LONGS_EQUAL(LED_ON, trace[3].old_state);
+    LONGS_EQUAL(LED_OFF, trace[3].new_state);
+
+    // Only the newest fit
+    LONGS_EQUAL(2, led_read_trace(trace, 2));
+    LONGS_EQUAL(4, trace[0].time_ms);
+    LONGS_EQUAL(6, trace[1].time_ms);
+
+    led_clear_trace();
+    LONGS_EQUAL(0, led_read_trace(trace, 8));
+    LONGS_EQUAL(-1, led_read_trace(NULL, 8));
+}
+
+// the ring keeps the newest transitions once it's full
+TEST(LEDTest, trace_overwrites_oldest)
+{
+    static led_trace_entry_t trace[LED_TRACE_SIZE];
+
+    int32_t led_id = define_and_register_led();
+
+    uint8_t sequence[] = {LED_OFF, LED_ON};
+    led_assign_sequence(led_id, define_and_register_sequence_super(2, 2, sequence));
+
+    for (int i = 0; i < LED_TRACE_SIZE + 10; i++)
+    {
+        led_update_state();
+    }
+
+    LONGS_EQUAL(LED_TRACE_SIZE + 10, led_get_trace_count());
+    LONGS_EQUAL(LED_TRACE_SIZE, led_read_trace(trace, LED_TRACE_SIZE));
+    LONGS_EQUAL(11, trace[0].time_ms);
+    LONGS_EQUAL(LED_TRACE_SIZE + 10, trace[LED_TRACE_SIZE - 1].time_ms);
+}
+#endif
 
 /********/
 /* TODO */
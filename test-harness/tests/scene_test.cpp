@@ -0,0 +1,214 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C" 
+{
+    #include "../../inc/led.h"
+    #include "../../inc/scene.h"
+    #include "../../inc/rgb_led.h"
+    #include "../spies/led_spy.h"
+    #include <string.h>
+}
+
+TEST_GROUP(SceneTest) 
+{
+    void setup()
+    {
+        led_init(1);
+        led_spy_init();
+    }
+
+    void teardown()
+    {
+    }
+
+    #define ARE_N_SCENES_REGISTERED(num)\
+        LONGS_EQUAL(num, scene_get_count());
+
+    int32_t define_and_register_led_super(bool enabled, pins_t pinout)
+    {
+        led_t new_led = {
+            .enabled = enabled,
+            .pinout = pinout,
+            .sequence_id = -1,
+            .sequence_idx = 0,
+            .timer_count = 0,
+            .sequence_initialized = false
+        };
+        
+        return led_register(new_led);
+    }
+
+    int32_t define_and_register_sequence_super(uint8_t length, uint32_t period, uint8_t * seq)
+    {
+        sequence_t sequence = {
+            .length = length,
+            .period = period
+        };
+
+        memcpy(sequence.sequence, seq, sequence.length);
+
+        return sequence_register(sequence);
+    }
+
+    void step_n_times(int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            led_update_state();
+        }
+    }
+};
+
+/********/
+/* ZERO */
+/********/
+
+TEST(SceneTest, no_scenes_registered_after_init)
+{
+    ARE_N_SCENES_REGISTERED(0);
+    LONGS_EQUAL(-1, scene_get_active());
+    LONGS_EQUAL(0, scene_get_stale_count());
+}
+
+TEST(SceneTest, activating_unregistered_scene_returns_error)
+{
+    LONGS_EQUAL(LED_ERR, scene_activate(0));
+    LONGS_EQUAL(LED_ERR, scene_activate(-1));
+}
+
+/*******/
+/* ONE */
+/*******/
+
+// a scene that references an unregistered led can't be registered
+TEST(SceneTest, scene_with_unregistered_led_cannot_be_registered)
+{
+    static const scene_entry_t scene[] = {
+        {.led_id = 0, .sequence_id = 1, .sequence_idx = 0, .enabled = true}
+    };
+
+    LONGS_EQUAL(-1, scene_register(scene, 1));
+    ARE_N_SCENES_REGISTERED(0);
+}
+
+// activating a scene doesn't change anything until the next update
+TEST(SceneTest, scene_is_applied_on_next_update)
+{
+    int32_t led_id = define_and_register_led_super(true, {.pin = 0});
+
+    static const scene_entry_t scene[] = {
+        {.led_id = 0, .sequence_id = 1, .sequence_idx = 0, .enabled = true}
+    };
+    int32_t scene_id = scene_register(scene, 1);
+
+    LONGS_EQUAL(LED_OK, scene_activate(scene_id));
+    LONGS_EQUAL(-1, led_get_sequence_id(led_id));
+    IS_LED_UNDEFINED(led_id);
+
+    step_n_times(1);
+
+    LONGS_EQUAL(1, led_get_sequence_id(led_id));
+    LONGS_EQUAL(scene_id, scene_get_active());
+    IS_LED_ON(led_id);
+}
+
+// a scene entry can start an LED part way through its sequence
+TEST(SceneTest, scene_entry_sets_sequence_position)
+{
+    define_and_register_led_super(true, {.pin = 0});
+    uint8_t sequence[] = {LED_OFF, LED_OFF, LED_ON, LED_ON};
+    int32_t seq_id = define_and_register_sequence_super(4, 4, sequence);
+
+    scene_entry_t scene[] = {
+        {.led_id = 0, .sequence_id = seq_id, .sequence_idx = 2, .enabled = true}
+    };
+    scene_activate(scene_register(scene, 1));
+
+    step_n_times(1);
+
+    IS_LED_ON(0);
+}
+
+/********/
+/* MANY */
+/********/
+
+// only the last scene activated before an update is applied
+TEST(SceneTest, last_scene_activated_before_update_wins)
+{
+    define_and_register_led_super(true, {.pin = 0});
+    define_and_register_led_super(true, {.pin = 1});
+
+    static const scene_entry_t idle[] = {
+        {.led_id = 0, .sequence_id = 1, .sequence_idx = 0, .enabled = true},
+        {.led_id = 1, .sequence_id = 1, .sequence_idx = 0, .enabled = true}
+    };
+    static const scene_entry_t error[] = {
+        {.led_id = 0, .sequence_id = 0, .sequence_idx = 0, .enabled = true},
+        {.led_id = 1, .sequence_id = 1, .sequence_idx = 0, .enabled = false}
+    };
+    int32_t idle_id = scene_register(idle, 2);
+    int32_t error_id = scene_register(error, 2);
+
+    scene_activate(idle_id);
+    scene_activate(error_id);
+    step_n_times(1);
+
+    LONGS_EQUAL(error_id, scene_get_active());
+    IS_LED_OFF(0);
+    IS_LED_UNDEFINED(1);
+    CHECK_FALSE(led_is_enabled(1));
+}
+
+// entries whose LED or sequence was unregistered after the scene was are skipped and counted
+TEST(SceneTest, stale_entries_are_skipped_and_counted)
+{
+    define_and_register_led_super(true, {.pin = 0});
+    int32_t led_id = define_and_register_led_super(true, {.pin = 1});
+    define_and_register_led_super(true, {.pin = 2});
+    uint8_t sequence[] = {LED_ON, LED_OFF};
+    int32_t seq_id = define_and_register_sequence_super(2, 2, sequence);
+
+    scene_entry_t scene[] = {
+        {.led_id = 0, .sequence_id = seq_id, .sequence_idx = 0, .enabled = true},
+        {.led_id = led_id, .sequence_id = 1, .sequence_idx = 0, .enabled = true},
+        {.led_id = 2, .sequence_id = 1, .sequence_idx = 0, .enabled = true}
+    };
+    int32_t scene_id = scene_register(scene, 3);
+
+    LONGS_EQUAL(SEQUENCE_OK, sequence_unregister(seq_id));
+    LONGS_EQUAL(LED_OK, led_unregister(led_id));
+    scene_activate(scene_id);
+    step_n_times(1);
+
+    LONGS_EQUAL(2, scene_get_stale_count());
+    LONGS_EQUAL(scene_id, scene_get_active());
+    LONGS_EQUAL(-1, led_get_sequence_id(0));
+    IS_LED_UNDEFINED(0);
+    IS_LED_ON(2);
+}
+
+// rgb leds can be put into scenes
+TEST(SceneTest, rgb_led_can_be_added_to_scene)
+{
+    rgb_led_init();
+    led_t new_led = {
+        .enabled = true,
+        .pinout = {.pin = 0},
+        .sequence_id = -1,
+        .sequence_idx = 0,
+        .timer_count = 0,
+        .sequence_initialized = false};
+    int32_t rgb_id = rgb_led_register({.pin = 0}, {.pin = 1}, {.pin = 2}, new_led);
+
+    scene_entry_t scene[3];
+    LONGS_EQUAL(LED_OK, rgb_scene_entries(rgb_id, RGB_RED, 0, true, scene));
+    LONGS_EQUAL(LED_ERR, rgb_scene_entries(rgb_id + 1, RGB_RED, 0, true, scene));
+
+    scene_activate(scene_register(scene, 3));
+    step_n_times(1);
+
+    LONGS_EQUAL(0xFF, led_spy_get_state(0));
+    LONGS_EQUAL(0x00, led_spy_get_state(1));
+    LONGS_EQUAL(0x00, led_spy_get_state(2));
+}
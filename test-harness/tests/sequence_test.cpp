@@ -170,10 +170,212 @@ TEST(SEQTest, register_max_sequences_plus_one_gives_error)
     uint16_t period = 100;
     uint8_t arr[] = {LED_OFF, LED_ON, LED_OFF};
 
+    // Identical sequences share a slot, so each one has a different period
     for (int i = 0; i < MAX_SEQUENCES; i++)
     {
-        define_and_register_sequence_super(length, period, arr);
+        define_and_register_sequence_super(length, period + i, arr);
     }
 
-    CHECK(-1 == define_and_register_sequence_super(length, period, arr));
-}
\ No newline at end of file
+    CHECK(-1 == define_and_register_sequence_super(length, period + MAX_SEQUENCES, arr));
+    // One already in the table can still be registered again
+    CHECK(-1 != define_and_register_sequence_super(length, period, arr));
+}
+
+// registering the same content again returns the same ID and counts a reference
+TEST(SEQTest, identical_sequences_share_an_id)
+{
+    uint8_t arr[] = {LED_OFF, LED_ON, LED_OFF};
+    int32_t id = define_and_register_sequence_super(3, 1000, arr);
+
+    LONGS_EQUAL(id, define_and_register_sequence_super(3, 1000, arr));
+    ARE_N_SEQUENCES_REGISTERED(1);
+    LONGS_EQUAL(2, sequence_get_refs(id));
+
+    // A different period, length or step is a different sequence
+    CHECK(id != define_and_register_sequence_super(3, 999, arr));
+    CHECK(id != define_and_register_sequence_super(2, 1000, arr));
+    arr[2] = LED_ON;
+    CHECK(id != define_and_register_sequence_super(3, 1000, arr));
+    ARE_N_SEQUENCES_REGISTERED(4);
+    LONGS_EQUAL(0, sequence_get_refs(4));
+}
+
+// steps past the length aren't part of the content
+TEST(SEQTest, steps_past_length_do_not_affect_interning)
+{
+    sequence_t a = {.sequence = {LED_ON, LED_OFF, 7}, .length = 2, .period = 10};
+    sequence_t b = {.sequence = {LED_ON, LED_OFF, 9}, .length = 2, .period = 10};
+
+    LONGS_EQUAL(sequence_hash(&a), sequence_hash(&b));
+    LONGS_EQUAL(-1, sequence_find(&a));
+    int32_t id = sequence_register(a);
+    LONGS_EQUAL(id, sequence_find(&b));
+    LONGS_EQUAL(id, sequence_register(b));
+}
+
+// a unique sequence gets its own slot and isn't handed out to other registrations
+TEST(SEQTest, unique_sequences_are_never_shared)
+{
+    sequence_t a = {.sequence = {LED_ON, LED_OFF}, .length = 2, .period = 10};
+
+    int32_t shared = sequence_register(a);
+    int32_t unique = sequence_register_unique(a);
+    CHECK(unique != shared);
+    LONGS_EQUAL(shared, sequence_find(&a));
+    LONGS_EQUAL(SEQUENCE_OK, sequence_unregister(shared));
+
+    // With only the unique copy left the next registration still gets a new slot
+    LONGS_EQUAL(-1, sequence_find(&a));
+    CHECK(sequence_register(a) != unique);
+    LONGS_EQUAL(1, sequence_get_refs(unique));
+}
+
+// the last unregistration frees the slot and the old ID stops working
+TEST(SEQTest, unregistered_sequence_slot_is_reused_with_new_id)
+{
+    uint8_t arr[] = {LED_OFF, LED_ON};
+    int32_t id = define_and_register_sequence_super(2, 10, arr);
+    define_and_register_sequence_super(2, 10, arr);
+    int32_t other = define_and_register_sequence_super(2, 20, arr);
+
+    // Interned twice, so it stays after the first unregistration
+    LONGS_EQUAL(SEQUENCE_OK, sequence_unregister(id));
+    CHECK(sequence_exists(id));
+    LONGS_EQUAL(SEQUENCE_OK, sequence_unregister(id));
+    CHECK_FALSE(sequence_exists(id));
+    POINTERS_EQUAL(NULL, sequence_get_from_id(id));
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_unregister(id));
+    ARE_N_SEQUENCES_REGISTERED(1);
+    LONGS_EQUAL(other, sequence_find(sequence_get_from_id(other)));
+
+    // The same content registered again gets the slot back under a new ID
+    int32_t again = define_and_register_sequence_super(2, 10, arr);
+    LONGS_EQUAL(HANDLE_SLOT(id), HANDLE_SLOT(again));
+    CHECK(id != again);
+    CHECK(sequence_exists(again));
+    CHECK_FALSE(sequence_exists(id));
+    ARE_N_SEQUENCES_REGISTERED(2);
+}
+
+// a table that keeps registering and unregistering patterns never fills up
+TEST(SEQTest, register_unregister_cycles_never_fill_table)
+{
+    uint8_t arr[] = {LED_OFF, LED_ON};
+
+    for (int i = 0; i < 10 * MAX_SEQUENCES; i++)
+    {
+        int32_t id = define_and_register_sequence_super(2, i, arr);
+        CHECK(id != -1);
+        LONGS_EQUAL(SEQUENCE_OK, sequence_unregister(id));
+    }
+
+    ARE_N_SEQUENCES_REGISTERED(0);
+}
+
+// once the reference count saturates it no longer drops to 0, the sequence is kept
+TEST(SEQTest, saturated_refs_are_sticky)
+{
+    uint8_t arr[] = {LED_OFF, LED_ON};
+    int32_t id = -1;
+
+    for (uint32_t i = 0; i <= UINT16_MAX; i++)
+    {
+        id = define_and_register_sequence_super(2, 10, arr);
+    }
+    LONGS_EQUAL(UINT16_MAX, sequence_get_refs(id));
+
+    for (uint32_t i = 0; i <= UINT16_MAX; i++)
+    {
+        LONGS_EQUAL(SEQUENCE_OK, sequence_unregister(id));
+    }
+    CHECK(sequence_exists(id));
+    LONGS_EQUAL(UINT16_MAX, sequence_get_refs(id));
+}
+
+// a pinned sequence can't be unregistered, other registrations of its content still can
+TEST(SEQTest, pinned_sequence_is_never_freed)
+{
+    uint8_t arr[] = {LED_OFF, LED_ON};
+    int32_t id = define_and_register_sequence_super(2, 10, arr);
+
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_pin(id + 1));
+    LONGS_EQUAL(SEQUENCE_OK, sequence_pin(id));
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_unregister(id));
+
+    LONGS_EQUAL(id, define_and_register_sequence_super(2, 10, arr));
+    LONGS_EQUAL(SEQUENCE_OK, sequence_unregister(id));
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_unregister(id));
+    CHECK(sequence_exists(id));
+    LONGS_EQUAL(1, sequence_get_refs(id));
+}
+
+// an update replaces the content but keeps the ID, and interning follows the new content
+TEST(SEQTest, update_replaces_content_in_place)
+{
+    uint8_t arr[] = {LED_OFF, LED_ON};
+    int32_t id = define_and_register_sequence_super(2, 10, arr);
+    sequence_t old_content = *sequence_get_from_id(id);
+    sequence_t new_content = {.sequence = {LED_ON, LED_ON, LED_OFF}, .length = 3, .period = 30};
+
+    LONGS_EQUAL(SEQUENCE_OK, sequence_update(id, new_content));
+
+    sequence_t * updated = sequence_get_from_id(id);
+    LONGS_EQUAL(3, updated->length);
+    LONGS_EQUAL(30, updated->period);
+    LONGS_EQUAL(LED_OFF, updated->sequence[2]);
+    LONGS_EQUAL(1, sequence_get_refs(id));
+    LONGS_EQUAL(id, sequence_find(&new_content));
+    LONGS_EQUAL(-1, sequence_find(&old_content));
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_update(id + 1, new_content));
+}
+
+// a staged version is only published by a commit and can be dropped until then
+TEST(SEQTest, staged_version_is_published_by_commit)
+{
+    sequence_ctx_t * ctx = sequence_get_default_ctx();
+    uint8_t arr[] = {LED_OFF, LED_ON};
+    int32_t id = define_and_register_sequence_super(2, 10, arr);
+    sequence_t new_content = {.sequence = {LED_ON, LED_ON, LED_OFF}, .length = 3, .period = 30};
+
+    LONGS_EQUAL(SEQUENCE_OK, sequence_ctx_stage(ctx, id, new_content));
+    LONGS_EQUAL(2, sequence_get_from_id(id)->length);
+    LONGS_EQUAL(3, sequence_ctx_get_staged(ctx, id)->length);
+
+    // One version waits at a time and nothing else replaces the content meanwhile
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_ctx_stage(ctx, id, new_content));
+    LONGS_EQUAL(SEQUENCE_ERROR, sequence_update(id, new_content));
+
+    CHECK(sequence_ctx_commit(ctx, id));
+    CHECK_FALSE(sequence_ctx_commit(ctx, id));
+    LONGS_EQUAL(3, sequence_get_from_id(id)->length);
+    LONGS_EQUAL(id, sequence_find(&new_content));
+    POINTERS_EQUAL(NULL, sequence_ctx_get_staged(ctx, id));
+
+    LONGS_EQUAL(SEQUENCE_OK, sequence_ctx_stage(ctx, id, *sequence_get_from_id(id)));
+    sequence_ctx_discard(ctx, id);
+    CHECK_FALSE(sequence_ctx_commit(ctx, id));
+    LONGS_EQUAL(SEQUENCE_OK, sequence_update(id, new_content));
+}
+
+// old versions aren't reused while an update is reading the table
+TEST(SEQTest, update_waits_for_readers_before_reusing_buffers)
+{
+    uint8_t arr[] = {LED_OFF, LED_ON};
+    int32_t id = define_and_register_sequence_super(2, 10, arr);
+    sequence_t content = *sequence_get_from_id(id);
+
+    sequence_ctx_read_begin(sequence_get_default_ctx());
+    sequence_t * read = sequence_get_from_id(id);
+
+    // Every buffer but the one being read can take a new version
+    uint32_t updates = 0;
+    while (sequence_update(id, content) == SEQUENCE_OK)
+    {
+        updates++;
+    }
+    LONGS_EQUAL(SEQUENCE_BUFFERS - 1, updates);
+    LONGS_EQUAL(LED_OFF, read->sequence[0]);
+
+    sequence_ctx_read_end(sequence_get_default_ctx());
+    LONGS_EQUAL(SEQUENCE_OK, sequence_update(id, content));
+}
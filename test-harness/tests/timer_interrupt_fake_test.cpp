@@ -0,0 +1,172 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+    #include "../../inc/led.h"
+    #include "../fakes/timer_interrupt_fake.h"
+    #include "../spies/led_spy.h"
+    #include <stdio.h>
+}
+
+static sequence_ctx_t sequences;
+static led_ctx_t ctx;
+
+TEST_GROUP(TimerFakeTest)
+{
+    void setup()
+    {
+        led_ctx_init(&ctx, &sequences, 1);
+        timer_fake_init(&ctx);
+        led_spy_init();
+    }
+
+    void teardown()
+    {
+    }
+
+    // Registers an LED on pin 0 blinking with the given period
+    void blink_led(uint32_t period)
+    {
+        sequence_t blink = {.sequence = {LED_OFF, LED_ON}, .length = 2, .period = period};
+        led_t led = {.enabled = true, .pinout = {.pin = 0}, .sequence_id = -1};
+
+        int32_t led_id = led_ctx_register(&ctx, led);
+        led_ctx_assign_sequence(&ctx, led_id, sequence_ctx_register(&sequences, blink));
+    }
+};
+
+// after init no time has passed and nothing has been written
+TEST(TimerFakeTest, nothing_recorded_after_init)
+{
+    LONGS_EQUAL(0, timer_fake_now());
+    LONGS_EQUAL(0, timer_fake_get_write_count());
+    LONGS_EQUAL(LED_UNDEFINED, timer_fake_get_state(0));
+    POINTERS_EQUAL(NULL, timer_fake_get_write(0));
+}
+
+// the timer fires once per period and every write is recorded with its time
+TEST(TimerFakeTest, periodic_timer_records_every_write)
+{
+    blink_led(10);
+
+    timer_fake_run_for(100);
+
+    LONGS_EQUAL(100, timer_fake_now());
+    LONGS_EQUAL(100, timer_fake_get_update_count());
+    LONGS_EQUAL(100, timer_fake_get_write_count());
+
+    const write_log_entry_t * first = timer_fake_get_write(0);
+    LONGS_EQUAL(1, first->time_ms);
+    LONGS_EQUAL(0, first->pinout.pin);
+    LONGS_EQUAL(LED_OFF, first->state);
+
+    // Off at 1ms then a change every 5ms
+    LONGS_EQUAL(21, timer_fake_get_change_count(0));
+    LONGS_EQUAL(100, timer_fake_get_last_change_ms(0));
+}
+
+// the timer fires at the period the context was initialised with
+TEST(TimerFakeTest, periodic_timer_fires_at_context_period)
+{
+    led_ctx_init(&ctx, &sequences, 5);
+    timer_fake_init(&ctx);
+    blink_led(10);
+
+    timer_fake_run_for(100);
+
+    LONGS_EQUAL(100, timer_fake_now());
+    LONGS_EQUAL(20, timer_fake_get_update_count());
+    LONGS_EQUAL(5, timer_fake_get_write(0)->time_ms);
+
+    // A change every update, a blink step is one period long
+    LONGS_EQUAL(20, timer_fake_get_change_count(0));
+    LONGS_EQUAL(100, timer_fake_get_last_change_ms(0));
+}
+
+// a tickless run only wakes for transitions, so hours of device time take a few thousand updates
+TEST(TimerFakeTest, tickless_timer_runs_hours_of_device_time)
+{
+    const uint32_t ten_hours_ms = 10u * 60u * 60u * 1000u;
+
+    blink_led(2000);
+
+    timer_fake_run_tickless(ten_hours_ms);
+
+    LONGS_EQUAL(ten_hours_ms, timer_fake_now());
+    // The first state at 0ms then a change every second
+    LONGS_EQUAL(36001, timer_fake_get_change_count(0));
+    LONGS_EQUAL(36001, timer_fake_get_update_count());
+    LONGS_EQUAL(ten_hours_ms, timer_fake_get_last_change_ms(0));
+    LONGS_EQUAL(LED_OFF, timer_fake_get_state(0));
+}
+
+// the update that moves the clock on to the end of a tickless run is counted like the others
+TEST(TimerFakeTest, tickless_run_counts_the_final_update)
+{
+    blink_led(2000);
+
+    // Woken at 0ms, 1000ms and 2000ms, then moved on to the end
+    timer_fake_run_tickless(2500);
+
+    LONGS_EQUAL(2500, timer_fake_now());
+    LONGS_EQUAL(4, timer_fake_get_update_count());
+    LONGS_EQUAL(500, led_ctx_get_next_wakeup(&ctx));
+}
+
+// the tickless and periodic timers show the same pattern
+TEST(TimerFakeTest, tickless_timer_matches_periodic_timer)
+{
+    blink_led(14);
+    timer_fake_run_for(1000);
+    uint32_t changes = timer_fake_get_change_count(0);
+    uint32_t last_change = timer_fake_get_last_change_ms(0);
+    led_state_t state = timer_fake_get_state(0);
+
+    setup();
+    blink_led(14);
+    timer_fake_run_tickless(1000);
+
+    LONGS_EQUAL(changes, timer_fake_get_change_count(0));
+    LONGS_EQUAL(last_change, timer_fake_get_last_change_ms(0));
+    LONGS_EQUAL(state, timer_fake_get_state(0));
+    CHECK(timer_fake_get_update_count() < 1000);
+}
+
+// only the first writes are kept but all of them are counted
+TEST(TimerFakeTest, record_keeps_first_writes)
+{
+    blink_led(10);
+
+    timer_fake_run_for(TIMER_FAKE_RECORD_MAX + 10);
+
+    LONGS_EQUAL(TIMER_FAKE_RECORD_MAX + 10, timer_fake_get_write_count());
+    CHECK(timer_fake_get_write(TIMER_FAKE_RECORD_MAX - 1) != NULL);
+    POINTERS_EQUAL(NULL, timer_fake_get_write(TIMER_FAKE_RECORD_MAX));
+}
+
+// hours of simulated output can be saved as a waveform
+TEST(TimerFakeTest, tickless_run_saved_as_vcd)
+{
+    const uint32_t one_hour_ms = 60u * 60u * 1000u;
+
+    blink_led(2000);
+    CHECK(led_spy_vcd_open("timer_fake_test.vcd", 1));
+
+    timer_fake_run_tickless(one_hour_ms);
+    led_spy_set_time(timer_fake_now());
+    led_spy_vcd_close();
+
+    FILE * file = fopen("timer_fake_test.vcd", "rb");
+    uint32_t lines = 0;
+    char line[64];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        lines++;
+    }
+    fclose(file);
+    remove("timer_fake_test.vcd");
+
+    // 9 header lines and the first state at 0ms, then a time and a state for each change every second
+    LONGS_EQUAL(LED_OFF, led_spy_get_state(0));
+    LONGS_EQUAL(10 + 2 * 3600, lines);
+}
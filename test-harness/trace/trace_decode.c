@@ -0,0 +1,78 @@
+/**
+ * @file trace_decode.c
+ * @brief Decodes a transition trace saved from a device into CSV for offline analysis. The input is 
+ * the binary led_trace_entry_t array either as copied out by led_read_trace(), or dumped straight 
+ * from the ring in a led_ctx_t, e.g. with gdb:
+ *
+ *     dump binary memory trace.bin &ctx.trace[0] &ctx.trace[LED_TRACE_SIZE]
+ *
+ * Usage: trace_decode file [trace_count]. Give the context's trace_count for a raw dump of the ring so
+ * the entries are put back in order, leave it out for the output of led_read_trace().
+ */
+
+#include "led.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char * state_name(uint8_t state)
+{
+    switch (state)
+    {
+        case LED_ON:
+            return "on";
+        case LED_OFF:
+            return "off";
+        case LED_UNDEFINED:
+            return "undefined";
+        default:
+            return "invalid";
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s file [trace_count]\n", argv[0]);
+        return 1;
+    }
+
+    FILE * in = fopen(argv[1], "rb");
+    if (in == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    static led_trace_entry_t entries[LED_TRACE_SIZE];
+    size_t count = fread(entries, sizeof(led_trace_entry_t), LED_TRACE_SIZE, in);
+    fclose(in);
+
+    size_t first = 0;
+    if (argc > 2)
+    {
+        // A raw ring holds only the entries written so far, the oldest is where the next one goes
+        unsigned long recorded = strtoul(argv[2], NULL, 0);
+
+        if (recorded < count)
+        {
+            count = recorded;
+        }
+        else if (count > 0)
+        {
+            first = recorded % count;
+        }
+    }
+
+    printf("time_ms,led_id,old_state,new_state\n");
+
+    for (size_t n = 0; n < count; n++)
+    {
+        const led_trace_entry_t * entry = &entries[(first + n) % count];
+
+        printf("%u,%u,%s,%s\n", (unsigned)entry->time_ms, (unsigned)entry->led_id,
+            state_name(entry->old_state), state_name(entry->new_state));
+    }
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef LED_USER_CONFIG_H
+#define LED_USER_CONFIG_H
+
+/**
+ * @brief The project's build options for the LED driver, see led_config.h for every option and its
+ * default. Included by the driver's headers, so the driver and the application always agree on them.
+ * e.g. for a small part with a handful of indicators
+ * #define LEDS_MAX 8
+ * #define MAX_SEQUENCES 8
+ * #define MAX_SEQUENCE 32
+ * #define LED_COMMAND_QUEUE_SIZE 8
+ */
+
+#endif